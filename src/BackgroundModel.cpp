@@ -0,0 +1,224 @@
+#include "BackgroundModel.hpp"
+
+#include <cstdlib>
+#include <algorithm>
+
+#include <opencv2/opencv.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+
+#include "Main.hpp"
+
+// Definition of the thresholds
+static const int ThresholdH = 25;
+static const int ThresholdS = 40;
+static const int ThresholdV = 65;
+
+// 8-bit hue wraps around at 180 (2 degrees per step), in 8.8 fixed point for the background
+static const int HueRange = 180;
+static const int HueRangeFixed = HueRange << 8;
+
+// the morphology spreads the foreground by at most this many pixels
+static const int MorphologyMargin = 6;
+
+// a background pixel follows the frames with a time constant of 2^8 frames, about 10 seconds
+static const int DefaultLearningShift = 8;
+
+// Thresholds one pixel against the background and blends it into the background when update is -1
+// (0 leaves the background as it is). Hue is compared and blended along the shorter way around the
+// circle, so reds near 0 and 179 match. Masks replace the branches, like in the vector code below.
+static inline uint8_t subtractPixel(uint8_t const* pixel, uint16_t* background, int update, int shift) {
+	int h = pixel[0];
+	int s = pixel[1];
+	int v = pixel[2];
+
+	int dh = std::abs(h - (background[0] >> 8));
+	dh = std::min(dh, HueRange - dh);
+	int foreground = ((dh > ThresholdH) & (std::abs(s - (background[1] >> 8)) > ThresholdS)) | (std::abs(v - (background[2] >> 8)) > ThresholdV);
+
+	int delta = (h << 8) - background[0];
+	delta -= HueRangeFixed & -(delta >= HueRangeFixed / 2);
+	delta += HueRangeFixed & -(delta < -HueRangeFixed / 2);
+	int hue = background[0] + ((delta >> shift) & update);
+	hue += HueRangeFixed & -(hue < 0);
+	hue -= HueRangeFixed & -(hue >= HueRangeFixed);
+
+	background[0] = static_cast<uint16_t>(hue);
+	background[1] = static_cast<uint16_t>(background[1] + ((((s << 8) - background[1]) >> shift) & update));
+	background[2] = static_cast<uint16_t>(background[2] + ((((v << 8) - background[2]) >> shift) & update));
+	return static_cast<uint8_t>(-foreground);
+}
+
+#if CV_SIMD
+// Blends 8.8 background values towards the frame values x (also 8.8) where update is -1.
+static inline cv::v_uint16 blendLinear(cv::v_uint16 const& background, cv::v_uint16 const& x, cv::v_int16 const& update, int shift) {
+	cv::v_uint32 b[2], f[2];
+	cv::v_int32 u[2];
+	cv::v_expand(background, b[0], b[1]);
+	cv::v_expand(x, f[0], f[1]);
+	cv::v_expand(update, u[0], u[1]);
+
+	cv::v_int32 result[2];
+	for (int k = 0; k < 2; ++k) {
+		cv::v_int32 base = cv::v_reinterpret_as_s32(b[k]);
+		cv::v_int32 delta = cv::v_sub(cv::v_reinterpret_as_s32(f[k]), base);
+		result[k] = cv::v_add(base, cv::v_and(delta >> shift, u[k]));
+	}
+	return cv::v_pack_u(result[0], result[1]);
+}
+
+// Same for hue, along the shorter way around the circle.
+static inline cv::v_uint16 blendHue(cv::v_uint16 const& background, cv::v_uint16 const& x, cv::v_int16 const& update, int shift) {
+	const cv::v_int32 range = cv::vx_setall_s32(HueRangeFixed);
+	const cv::v_int32 half = cv::vx_setall_s32(HueRangeFixed / 2);
+	const cv::v_int32 minusHalf = cv::vx_setall_s32(-HueRangeFixed / 2);
+	const cv::v_int32 zero = cv::vx_setzero_s32();
+
+	cv::v_uint32 b[2], f[2];
+	cv::v_int32 u[2];
+	cv::v_expand(background, b[0], b[1]);
+	cv::v_expand(x, f[0], f[1]);
+	cv::v_expand(update, u[0], u[1]);
+
+	cv::v_int32 result[2];
+	for (int k = 0; k < 2; ++k) {
+		cv::v_int32 base = cv::v_reinterpret_as_s32(b[k]);
+		cv::v_int32 delta = cv::v_sub(cv::v_reinterpret_as_s32(f[k]), base);
+		delta = cv::v_sub(delta, cv::v_and(range, cv::v_ge(delta, half)));
+		delta = cv::v_add(delta, cv::v_and(range, cv::v_lt(delta, minusHalf)));
+		cv::v_int32 hue = cv::v_add(base, cv::v_and(delta >> shift, u[k]));
+		hue = cv::v_add(hue, cv::v_and(range, cv::v_lt(hue, zero)));
+		result[k] = cv::v_sub(hue, cv::v_and(range, cv::v_ge(hue, range)));
+	}
+	return cv::v_pack_u(result[0], result[1]);
+}
+#endif
+
+// Thresholds the pixels start to end of a row and updates their background, a negative shift
+// keeps the background fixed. The pointers are to the start of the row.
+static void subtractRow(uint8_t const* hsv, uint16_t* background, uint8_t const* last, uint8_t* out, int start, int end, int shift) {
+	const bool adapt = shift >= 0;
+	const int adaptMask = -static_cast<int>(adapt);
+	int x = start;
+
+#if CV_SIMD
+	// a block of pixels at a time: the 8-bit channels are compared as they are, the 8.8 background is
+	// blended in 32-bit lanes; the rest of the row is left to the scalar code
+	const int step = cv::VTraits<cv::v_uint8>::vlanes();
+	const int half = step / 2;
+	const cv::v_uint8 thresholdH = cv::vx_setall_u8(ThresholdH);
+	const cv::v_uint8 thresholdS = cv::vx_setall_u8(ThresholdS);
+	const cv::v_uint8 thresholdV = cv::vx_setall_u8(ThresholdV);
+	const cv::v_uint8 hueRange = cv::vx_setall_u8(HueRange);
+	const cv::v_uint8 zero = cv::vx_setzero_u8();
+
+	for (; x <= end - step; x += step) {
+		cv::v_uint8 h, s, v;
+		cv::v_load_deinterleave(hsv + 3 * x, h, s, v);
+
+		cv::v_uint16 bh[2], bs[2], bv[2];
+		cv::v_load_deinterleave(background + 3 * x, bh[0], bs[0], bv[0]);
+		cv::v_load_deinterleave(background + 3 * (x + half), bh[1], bs[1], bv[1]);
+
+		cv::v_uint8 dh = cv::v_absdiff(h, cv::v_pack(cv::v_shr<8>(bh[0]), cv::v_shr<8>(bh[1])));
+		dh = cv::v_min(dh, cv::v_sub(hueRange, dh));
+		cv::v_uint8 ds = cv::v_absdiff(s, cv::v_pack(cv::v_shr<8>(bs[0]), cv::v_shr<8>(bs[1])));
+		cv::v_uint8 dv = cv::v_absdiff(v, cv::v_pack(cv::v_shr<8>(bv[0]), cv::v_shr<8>(bv[1])));
+		cv::v_store(out + x, cv::v_or(cv::v_and(cv::v_gt(dh, thresholdH), cv::v_gt(ds, thresholdS)), cv::v_gt(dv, thresholdV)));
+
+		if (!adapt) {
+			continue;
+		}
+
+		// the update mask is widened by sign extension, so it stays all ones
+		cv::v_int16 update[2];
+		cv::v_expand(cv::v_reinterpret_as_s8(cv::v_eq(cv::vx_load(last + x), zero)), update[0], update[1]);
+
+		cv::v_uint16 fh[2], fs[2], fv[2];
+		cv::v_expand(h, fh[0], fh[1]);
+		cv::v_expand(s, fs[0], fs[1]);
+		cv::v_expand(v, fv[0], fv[1]);
+
+		for (int k = 0; k < 2; ++k) {
+			cv::v_uint16 nh = blendHue(bh[k], cv::v_shl<8>(fh[k]), update[k], shift);
+			cv::v_uint16 ns = blendLinear(bs[k], cv::v_shl<8>(fs[k]), update[k], shift);
+			cv::v_uint16 nv = blendLinear(bv[k], cv::v_shl<8>(fv[k]), update[k], shift);
+			cv::v_store_interleave(background + 3 * (x + k * half), nh, ns, nv);
+		}
+	}
+#endif
+
+	for (; x < end; ++x) {
+		int update = -static_cast<int>(last[x] == 0) & adaptMask;
+		out[x] = subtractPixel(hsv + 3 * x, background + 3 * x, update, adapt ? shift : 0);
+	}
+}
+
+BackgroundModel::BackgroundModel() : LearningShift(DefaultLearningShift) {
+}
+
+void BackgroundModel::Init(cv::Mat const& background) {
+	cv::cvtColor(background, hsv, cv::COLOR_BGR2HSV);
+	hsv.convertTo(mean, CV_16UC3, 256.0);
+	previous = cv::Mat::zeros(background.size(), CV_8U);
+	raw = cv::Mat::zeros(background.size(), CV_8U);
+
+	spans.assign(background.rows, cv::Range(0, background.cols));
+	bounds = cv::Rect(0, 0, background.cols, background.rows);
+}
+
+void BackgroundModel::SetRegion(std::vector<cv::Range> const& rowSpans, cv::Rect rowBounds) {
+	if (casti(rowSpans.size()) != mean.rows) {
+		return;
+	}
+
+	spans = rowSpans;
+	bounds = rowBounds & cv::Rect(0, 0, mean.cols, mean.rows);
+
+	// pixels outside the region are never written, so they stay background
+	raw.setTo(0);
+	previous.setTo(0);
+}
+
+cv::Mat BackgroundModel::Background() const {
+	cv::Mat background;
+	mean.convertTo(background, CV_8UC3, 1.0 / 256.0);
+	return background;
+}
+
+cv::Mat BackgroundModel::Apply(cv::Mat const& frame) {
+	cv::Mat mask = cv::Mat::zeros(frame.size(), CV_8U);
+	if (bounds.empty()) {
+		previous = mask;
+		return mask;
+	}
+
+	// Colour transformation from rgb to hsv for the current frame, within the region
+	hsv.create(frame.size(), CV_8UC3);
+	cv::Mat hsvRegion = hsv(bounds);
+	cv::cvtColor(frame(bounds), hsvRegion, cv::COLOR_BGR2HSV);
+
+	// the update is skipped entirely for a fixed background
+	const int shift = LearningShift;
+	const bool adapt = shift > 0;
+
+	// a pixel is foreground when both its hue and saturation differ from the background, or its value does;
+	// pixels that were background in the last frame are blended into the background in the same pass
+	for (int y = bounds.y; y < bounds.y + bounds.height; ++y) {
+		cv::Range const& span = spans[y];
+		subtractRow(hsv.ptr<uint8_t>(y), mean.ptr<uint16_t>(y), previous.ptr<uint8_t>(y), raw.ptr<uint8_t>(y),
+			span.start, span.end, adapt ? shift : -1);
+	}
+
+	// Erosion & dilation to connect blobs and remove noisy points, around the region only
+	cv::Rect area = cv::Rect(bounds.x - MorphologyMargin, bounds.y - MorphologyMargin,
+		bounds.width + 2 * MorphologyMargin, bounds.height + 2 * MorphologyMargin) & cv::Rect(0, 0, mask.cols, mask.rows);
+	cv::Mat maskArea = mask(area);
+	cv::Mat element = cv::getStructuringElement(cv::MORPH_CROSS, cv::Size(5, 5));
+	cv::erode(raw(area), maskArea, cv::Mat());
+	cv::dilate(maskArea, maskArea, element, cv::Point(-1, -1), 2);
+	cv::erode(maskArea, maskArea, cv::Mat());
+
+	// the mask is returned, so it is only read here in the next frame
+	previous = mask;
+	return mask;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+// Background of a single view in HSV space, for background subtraction. The background starts
+// as a captured image and follows slow changes in the lighting: every frame, the pixels that
+// were background in the previous frame move a fraction towards the new frame, in the same pass
+// that finds the foreground.
+class BackgroundModel {
+public:
+	BackgroundModel();
+
+public:
+	void Init(cv::Mat const& background);	// BGR image of the empty scene
+	void SetRegion(std::vector<cv::Range> const& spans, cv::Rect bounds);	// columns of each row to process, the rest is background
+	cv::Mat Apply(cv::Mat const& frame);	// foreground mask (0 or 255) of a BGR frame, updates the background
+
+	cv::Mat Background() const;				// current background in HSV
+
+public:
+	int LearningShift;	// background pixels move 1 / 2^LearningShift towards each frame (0 keeps the background fixed)
+
+private:
+	cv::Mat mean;		// HSV background in 8.8 fixed point (CV_16UC3)
+	cv::Mat hsv;
+	cv::Mat raw;		// thresholded difference, before the morphology
+	cv::Mat previous;	// mask of the previous frame, its background pixels are updated
+
+	std::vector<cv::Range> spans;
+	cv::Rect bounds;
+};
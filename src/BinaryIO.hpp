@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+
+// Little helpers for the binary stream formats: values are stored in native (little-endian) byte order.
+namespace BinaryIO {
+	template <typename T>
+	void put(std::vector<uint8_t>& out, T value) {
+		size_t offset = out.size();
+		out.resize(offset + sizeof(T));
+		std::memcpy(out.data() + offset, &value, sizeof(T));
+	}
+
+	template <typename T>
+	bool get(std::vector<uint8_t> const& in, size_t& offset, T& value) {
+		if (offset + sizeof(T) > in.size()) {
+			return false;
+		}
+		std::memcpy(&value, in.data() + offset, sizeof(T));
+		offset += sizeof(T);
+		return true;
+	}
+
+	template <typename T>
+	bool read(std::ifstream& in, T& value) {
+		return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+	}
+
+	// unsigned LEB128: 7 bits per byte, the high bit marks that more bytes follow
+	inline void putVarint(std::vector<uint8_t>& out, uint32_t value) {
+		while (value >= 0x80) {
+			out.push_back(static_cast<uint8_t>(value | 0x80));
+			value >>= 7;
+		}
+		out.push_back(static_cast<uint8_t>(value));
+	}
+
+	inline bool getVarint(std::vector<uint8_t> const& in, size_t& offset, uint32_t& value) {
+		value = 0;
+		for (int shift = 0; shift < 35 && offset < in.size(); shift += 7) {
+			uint8_t byte = in[offset++];
+			value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+			if (!(byte & 0x80)) {
+				return true;
+			}
+		}
+		return false;
+	}
+}
@@ -1,6 +1,8 @@
 #include "Camera.hpp"
 
+#include <cmath>
 #include <vector>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <algorithm>
@@ -8,7 +10,7 @@
 #include <opencv2/opencv.hpp>
 
 Camera::Camera(int index, int viewWidth, int viewHeight, std::string camIniFile) : 
-viewSize(viewWidth, viewHeight) {
+UndistortForeground(false), viewSize(viewWidth, viewHeight) {
 	LoadParams(camIniFile);
 
 	// colors
@@ -27,9 +29,10 @@ viewSize(viewWidth, viewHeight) {
 
 	ComputeLocation();
 	InvertRt();
+	cacheProjection();
 	WorldCoord();
 
-	std::cout << "Camera " << index + 1 << " : coordinates ready" << std::endl;
+	std::cerr << "Camera " << index + 1 << " : coordinates ready" << std::endl;
 }
 
 // load calibration files
@@ -38,11 +41,14 @@ void Camera::LoadParams(std::string iniFileName) {
 	translationVector = cv::Mat(1, 3, CV_32FC1);
 	intrinsicMatrix = cv::Mat(3, 3, CV_32FC1);
 	distortionCoeffs = cv::Mat(4, 1, CV_32FC1);
-	rotationMatrix = cv::Mat(3, 3, CV_32FC1);
 
 	std::string line;
 	std::ifstream file(iniFileName);
 
+	if (!file.is_open()) {
+		std::cerr << "Unable to open calibration file " << iniFileName << std::endl;
+	}
+
 	// load settings
 	if (file.is_open()) {
 		float value;
@@ -70,94 +76,43 @@ void Camera::LoadParams(std::string iniFileName) {
 }
 
 void Camera::ComputeLocation() {
-	float rMatrix[9];
-	float rVector[3];
-
-	rVector[0] = rotationVector.at<float>(0, 0);
-	rVector[1] = rotationVector.at<float>(0, 1);
-	rVector[2] = rotationVector.at<float>(0, 2);
-
-	cv::Mat rMatrixTemp = cv::Mat(3, 3, CV_32FC1, rMatrix);
-	cv::Mat rVectorTemp = cv::Mat(1, 3, CV_32FC1, rVector);
-
 	// compute rotation matrix by Rodrigues transform
-	cv::Rodrigues(rVectorTemp, rMatrixTemp);
-
-	// save rotation matrix
-	// TODO: OPTIMIZE
-	for (int i = 0; i < 3; i ++) {
-		for (int j = 0; j < 3; j ++) {
-			rotationMatrix.at<float>(i, j) = rMatrixTemp.at<float>(i, j);
-		}
-	}
-
-	// Combine transformations into one matrix
-	// Mind the order; rotations are not commutative
-	float tmat[4][4] = { 
-		{ 1.f, 0.f, 0.f, 0.f },
-		{ 0.f, 1.f, 0.f, 0.f },
-		{ 0.f, 0.f, 1.f, 0.f },
-		{ 
-			translationVector.at<float>(0, 0) * -1.f,
-			translationVector.at<float>(0, 1) * -1.f,
-			translationVector.at<float>(0, 2) * -1.f,
-			1.f 
-		}
-	};
+	cv::Rodrigues(rotationVector, rotationMatrix);
 
-	float rmat[4][4] = { 
-		{ rMatrix[0], rMatrix[1], rMatrix[2], 0.f },
-		{ rMatrix[3], rMatrix[4], rMatrix[5], 0.f },
-		{ rMatrix[6], rMatrix[7], rMatrix[8], 0.f },
-		{ 0.f, 0.f, 0.f, 1.f }
-	};
-	
-	// matrix multiplication
-	float rm[4][4];
-	for (int i = 0; i <= 3; i++) {
-		for (int j = 0; j <= 3; j++) {
-			rm[i][j] = 0.0;
-			for (int k = 0; k <= 3; k++) {
-				rm[i][j] += tmat[i][k] * rmat[k][j];
-			}
-		}
-	}
-
-	PosWorld = cv::Point3f(
-		rm[0][0] + rm[3][0],
-		rm[1][1] + rm[3][1],
-		rm[2][2] + rm[3][2]
-	);
+	// camera center in world coordinates: C = -R^T t
+	cv::Vec3f t = translation();
+	cv::Vec3f c = -(rotationMatrix.t() * t);
+	PosWorld = cv::Point3f(c[0], c[1], c[2]);
 }
 
 void Camera::InvertRt() {
 	// Xi = K[R/t]Xw 
 	// t = -RC
-	Rt = cv::Mat(4, 4, CV_64FC1);
-	inverseRt = cv::Mat(4, 4, CV_64FC1);
+	cv::Matx33f const& R = rotationMatrix;
+	cv::Vec3f t = translation();
 
 	// [R|t] 
-	Rt.at<float>(0, 0) = rotationMatrix.at<float>(0, 0);
-	Rt.at<float>(0, 1) = rotationMatrix.at<float>(0, 1);
-	Rt.at<float>(0, 2) = rotationMatrix.at<float>(0, 2);
-	Rt.at<float>(0, 3) = translationVector.at<float>(0, 0);
-
-	Rt.at<float>(1, 0) = rotationMatrix.at<float>(1, 0);
-	Rt.at<float>(1, 1) = rotationMatrix.at<float>(1, 1);
-	Rt.at<float>(1, 2) = rotationMatrix.at<float>(1, 2);
-	Rt.at<float>(1, 3) = translationVector.at<float>(0, 1);
-
-	Rt.at<float>(2, 0) = rotationMatrix.at<float>(2, 0);
-	Rt.at<float>(2, 1) = rotationMatrix.at<float>(2, 1);
-	Rt.at<float>(2, 2) = rotationMatrix.at<float>(2, 2);
-	Rt.at<float>(2, 3) = translationVector.at<float>(0, 2);
-
-	Rt.at<float>(3, 0) = 0.f;
-	Rt.at<float>(3, 1) = 0.f;
-	Rt.at<float>(3, 2) = 0.f;
-	Rt.at<float>(3, 3) = 1.f;
+	Rt = cv::Matx44f(
+		R(0, 0), R(0, 1), R(0, 2), t[0],
+		R(1, 0), R(1, 1), R(1, 2), t[1],
+		R(2, 0), R(2, 1), R(2, 2), t[2],
+		0.f, 0.f, 0.f, 1.f);
+
+	// [R^T|-R^T t], the inverse of a rigid transformation
+	cv::Matx33f Ri = R.t();
+	cv::Vec3f ti = -(Ri * t);
+	inverseRt = cv::Matx44f(
+		Ri(0, 0), Ri(0, 1), Ri(0, 2), ti[0],
+		Ri(1, 0), Ri(1, 1), Ri(1, 2), ti[1],
+		Ri(2, 0), Ri(2, 1), Ri(2, 2), ti[2],
+		0.f, 0.f, 0.f, 1.f);
+}
 
-	cv::invert(Rt, inverseRt);
+cv::Vec3f Camera::translation() const {
+	return cv::Vec3f(
+		translationVector.at<float>(0, 0),
+		translationVector.at<float>(0, 1),
+		translationVector.at<float>(0, 2));
 }
 
 void Camera::MultMatrix(float rm[4][4], const float m1[4][4], const float m2[4][4]) {
@@ -171,21 +126,36 @@ void Camera::MultMatrix(float rm[4][4], const float m1[4][4], const float m2[4][
 	}
 }
 
-cv::Point Camera::ProjectOnView(cv::Point3f obP) {
-	cv::Point pt;
-	cv::Mat objectPoints = cv::Mat(3, 3, CV_32FC1);
-	cv::Mat imagePoints = cv::Mat(3, 2, CV_32FC1);
-
-	objectPoints.at<float>(0, 0) = obP.x;
-	objectPoints.at<float>(0, 1) = obP.y;
-	objectPoints.at<float>(0, 2) = obP.z;
+// copy the calibration into plain arrays, so that projection does not go through cv::Mat
+void Camera::cacheProjection() {
+	for (int i = 0; i < 3; i ++) {
+		for (int j = 0; j < 4; j ++) {
+			projection[i * 4 + j] = Rt(i, j);
+		}
+	}
 
-	cv::projectPoints(objectPoints, rotationVector, translationVector, intrinsicMatrix, distortionCoeffs, imagePoints);
+	for (int i = 0; i < 4; i ++) {
+		distortion[i] = distortionCoeffs.at<float>(i, 0);
+	}
+}
 
-	pt.x = static_cast<int>(imagePoints.at<float>(0, 0));
-	pt.y = static_cast<int>(imagePoints.at<float>(0, 1));
+cv::Point Camera::ProjectOnView(cv::Point3f obP) {
+	cv::Point2f pt = Project(obP);
+	return cv::Point(static_cast<int>(pt.x), static_cast<int>(pt.y));
+}
 
-	return pt;
+// project a batch of world points; a plain loop over the inlined projection
+void Camera::Project(cv::Point3f const* points, cv::Point2f* pixels, int count, bool distort) const {
+	if (distort) {
+		for (int i = 0; i < count; i ++) {
+			pixels[i] = Project(points[i], true);
+		}
+	}
+	else {
+		for (int i = 0; i < count; i ++) {
+			pixels[i] = Project(points[i], false);
+		}
+	}
 }
 
 void Camera::WorldCoord() {
@@ -220,21 +190,225 @@ void Camera::WorldCoord() {
 }
 
 // convert a 2D point on view to 3D world coordinates
-cv::Point3f Camera::Point2DtoWorld3D(cv::Point pt) {
-	return camPoint3DtoWorld3D(cv::Point3f(float(pt.x - px), float(pt.y - py), (fx + fy) / 2));
-}
-
-cv::Point3f Camera::camPoint3DtoWorld3D(cv::Point3f camPt3D) {
-	cv::Mat Xc = cv::Mat(4, 1, CV_64FC1);
-	Xc.at<float>(0, 0) = camPt3D.x;
-	Xc.at<float>(1, 0) = camPt3D.y;
-	Xc.at<float>(2, 0) = camPt3D.z;
-	Xc.at<float>(3, 0) = 1.f;
-
-	cv::Mat Xw = inverseRt * Xc;
-	return cv::Point3f(
-		Xw.at<float>(0, 0),
-		Xw.at<float>(1, 0),
-		Xw.at<float>(2, 0)
-	);
+cv::Point3f Camera::Point2DtoWorld3D(cv::Point pt) const {
+	float f = (fx + fy) / 2;
+
+	// undistorted ray through the pixel
+	if (!rayTable.empty() && pt.x >= 0 && pt.y >= 0 && pt.x < rayTable.cols && pt.y < rayTable.rows) {
+		cv::Vec2f ray = rayTable.at<cv::Vec2f>(pt.y, pt.x);
+		return camPoint3DtoWorld3D(cv::Point3f(ray[0] * f, ray[1] * f, f));
+	}
+
+	return camPoint3DtoWorld3D(cv::Point3f(float(pt.x - px), float(pt.y - py), f));
+}
+
+// convert a batch of 2D points on view to 3D world coordinates
+void Camera::Point2DtoWorld3D(cv::Point const* pts, cv::Point3f* worldPts, int count) const {
+	for (int i = 0; i < count; i ++) {
+		worldPts[i] = Point2DtoWorld3D(pts[i]);
+	}
+}
+
+cv::Point3f Camera::camPoint3DtoWorld3D(cv::Point3f camPt3D) const {
+	cv::Vec4f Xw = inverseRt * cv::Vec4f(camPt3D.x, camPt3D.y, camPt3D.z, 1.f);
+	return cv::Point3f(Xw[0], Xw[1], Xw[2]);
+}
+
+// Builds the remap tables for mask undistortion and the per-pixel ray table. Both only
+// depend on the intrinsics, so they are cached on disk when a cache file is given.
+void Camera::InitUndistortion(std::string const& cacheFile, bool remapTables) {
+	if (!cacheFile.empty() && loadUndistortion(cacheFile, remapTables)) {
+		return;
+	}
+
+	cv::Mat K = intrinsicMatrix;
+	cv::Mat D = distortionCoeffs;
+
+	// undistorted view with the same intrinsics
+	undistortMap1.release();
+	undistortMap2.release();
+	if (remapTables) {
+		cv::initUndistortRectifyMap(K, D, cv::noArray(), K, viewSize, CV_16SC2, undistortMap1, undistortMap2);
+	}
+
+	// undistorted normalized coordinates of every pixel
+	std::vector<cv::Point2f> pixels;
+	pixels.reserve(viewSize.area());
+	for (int y = 0; y < viewSize.height; y ++) {
+		for (int x = 0; x < viewSize.width; x ++) {
+			pixels.push_back(cv::Point2f(float(x), float(y)));
+		}
+	}
+
+	std::vector<cv::Point2f> rays;
+	cv::undistortPoints(pixels, rays, K, D);
+	rayTable = cv::Mat(rays, true).reshape(2, viewSize.height);
+
+	if (!cacheFile.empty()) {
+		saveUndistortion(cacheFile);
+	}
+}
+
+void Camera::UndistortMask(cv::Mat const& mask, cv::Mat& undistorted) const {
+	if (undistortMap1.empty()) {
+		std::cerr << "No undistortion remap tables, the mask is used as it is" << std::endl;
+		mask.copyTo(undistorted);
+		return;
+	}
+	cv::remap(mask, undistorted, undistortMap1, undistortMap2, cv::INTER_NEAREST);
+}
+
+// undistortion cache: magic, version, view size, calibration and whether the remap tables are
+// stored, followed by the remap tables (if stored) and the ray table
+static const uint32_t UndistortionMagic = 0x4455424f; // "OBUD"
+static const uint32_t UndistortionVersion = 2;
+
+bool Camera::loadUndistortion(std::string const& cacheFile, bool remapTables) {
+	std::ifstream file(cacheFile, std::ios::binary);
+	if (!file.is_open()) {
+		return false;
+	}
+
+	uint32_t magic = 0;
+	uint32_t version = 0;
+	int32_t size[2] = { 0, 0 };
+	float params[8];
+	uint32_t hasRemap = 0;
+	file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+	file.read(reinterpret_cast<char*>(&version), sizeof(version));
+	file.read(reinterpret_cast<char*>(size), sizeof(size));
+	file.read(reinterpret_cast<char*>(params), sizeof(params));
+	file.read(reinterpret_cast<char*>(&hasRemap), sizeof(hasRemap));
+
+	// the cache must belong to this calibration
+	float expected[8] = { fx, fy, px, py, distortion[0], distortion[1], distortion[2], distortion[3] };
+	if (!file || magic != UndistortionMagic || version != UndistortionVersion ||
+		size[0] != viewSize.width || size[1] != viewSize.height ||
+		std::memcmp(params, expected, sizeof(params)) != 0) {
+		return false;
+	}
+
+	// a cache without the remap tables is rebuilt when they are needed
+	if (remapTables && !hasRemap) {
+		return false;
+	}
+
+	cv::Mat map1;
+	cv::Mat map2;
+	cv::Mat rays(viewSize, CV_32FC2);
+	if (hasRemap) {
+		map1.create(viewSize, CV_16SC2);
+		map2.create(viewSize, CV_16UC1);
+		file.read(reinterpret_cast<char*>(map1.data), map1.total() * map1.elemSize());
+		file.read(reinterpret_cast<char*>(map2.data), map2.total() * map2.elemSize());
+	}
+	file.read(reinterpret_cast<char*>(rays.data), rays.total() * rays.elemSize());
+	if (!file) {
+		return false;
+	}
+
+	undistortMap1 = map1;
+	undistortMap2 = map2;
+	rayTable = rays;
+	return true;
+}
+
+void Camera::saveUndistortion(std::string const& cacheFile) const {
+	std::ofstream file(cacheFile, std::ios::binary);
+	if (!file.is_open()) {
+		std::cerr << "Unable to write undistortion cache " << cacheFile << std::endl;
+		return;
+	}
+
+	int32_t size[2] = { viewSize.width, viewSize.height };
+	float params[8] = { fx, fy, px, py, distortion[0], distortion[1], distortion[2], distortion[3] };
+	file.write(reinterpret_cast<char const*>(&UndistortionMagic), sizeof(UndistortionMagic));
+	file.write(reinterpret_cast<char const*>(&UndistortionVersion), sizeof(UndistortionVersion));
+	file.write(reinterpret_cast<char const*>(size), sizeof(size));
+	uint32_t hasRemap = undistortMap1.empty() ? 0 : 1;
+	file.write(reinterpret_cast<char const*>(params), sizeof(params));
+	file.write(reinterpret_cast<char const*>(&hasRemap), sizeof(hasRemap));
+	if (hasRemap) {
+		file.write(reinterpret_cast<char const*>(undistortMap1.data), undistortMap1.total() * undistortMap1.elemSize());
+		file.write(reinterpret_cast<char const*>(undistortMap2.data), undistortMap2.total() * undistortMap2.elemSize());
+	}
+	file.write(reinterpret_cast<char const*>(rayTable.data), rayTable.total() * rayTable.elemSize());
+}
+
+// Projects the edges of the volume, the convex hull of these points (widened by a margin for the
+// morphology of the background subtraction) is the region that can contain anything of interest.
+void Camera::InitVolumeRegion(std::vector<cv::Point3f> const& corners) {
+	// the whole view, unless the volume projects to a proper region
+	VolumeSpans.assign(viewSize.height, cv::Range(0, viewSize.width));
+	VolumeBounds = cv::Rect(0, 0, viewSize.width, viewSize.height);
+	if (corners.size() != 8) {
+		return;
+	}
+
+	// the edges are sampled, because lens distortion bends them
+	static const int edges[12][2] = {
+		{ 0, 1 }, { 1, 2 }, { 2, 3 }, { 3, 0 },
+		{ 4, 5 }, { 5, 6 }, { 6, 7 }, { 7, 4 },
+		{ 0, 4 }, { 1, 5 }, { 2, 6 }, { 3, 7 }
+	};
+	const int samples = 32;
+	const int margin = 8;
+
+	std::vector<cv::Point3f> points;
+	for (auto const& edge : edges) {
+		for (int s = 0; s <= samples; ++s) {
+			float t = static_cast<float>(s) / samples;
+			points.push_back(corners[edge[0]] * (1.f - t) + corners[edge[1]] * t);
+		}
+	}
+
+	std::vector<cv::Point2f> pixels(points.size());
+	Project(points.data(), pixels.data(), static_cast<int>(points.size()));
+
+	std::vector<cv::Point> hull;
+	std::vector<cv::Point> projected;
+	for (cv::Point2f const& pixel : pixels) {
+		if (!std::isfinite(pixel.x) || !std::isfinite(pixel.y)) {
+			return;
+		}
+
+		// far outside the view the points only need to push the hull across the border
+		projected.push_back(cv::Point(
+			static_cast<int>(std::clamp(pixel.x, -1.f * viewSize.width, 2.f * viewSize.width)),
+			static_cast<int>(std::clamp(pixel.y, -1.f * viewSize.height, 2.f * viewSize.height))));
+	}
+	cv::convexHull(projected, hull);
+	if (cv::contourArea(hull) <= 0.0) {
+		return;
+	}
+
+	cv::Mat region = cv::Mat::zeros(viewSize, CV_8U);
+	cv::fillConvexPoly(region, hull, cv::Scalar(255));
+	cv::dilate(region, region, cv::getStructuringElement(cv::MORPH_RECT, cv::Size(2 * margin + 1, 2 * margin + 1)));
+
+	int top = viewSize.height;
+	int bottom = 0;
+	int left = viewSize.width;
+	int right = 0;
+	for (int y = 0; y < viewSize.height; ++y) {
+		uint8_t const* row = region.ptr<uint8_t>(y);
+		int start = 0;
+		while (start < viewSize.width && row[start] == 0) {
+			start++;
+		}
+		int end = viewSize.width;
+		while (end > start && row[end - 1] == 0) {
+			end--;
+		}
+
+		VolumeSpans[y] = cv::Range(start, std::max(start, end));
+		if (end > start) {
+			top = std::min(top, y);
+			bottom = y + 1;
+			left = std::min(left, start);
+			right = std::max(right, end);
+		}
+	}
+
+	VolumeBounds = (bottom > top) ? cv::Rect(left, top, right - left, bottom - top) : cv::Rect();
 }
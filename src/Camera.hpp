@@ -19,16 +19,63 @@ public:
 	void WorldCoord();				// camera corners in world coordinate
 	cv::Point ProjectOnView(cv::Point3f);
 
+	// project world points onto the view, including lens distortion unless disabled
+	inline cv::Point2f Project(cv::Point3f const& p, bool distort = true) const {
+		// normalized image coordinates
+		float x = projection[0] * p.x + projection[1] * p.y + projection[2] * p.z + projection[3];
+		float y = projection[4] * p.x + projection[5] * p.y + projection[6] * p.z + projection[7];
+		float z = projection[8] * p.x + projection[9] * p.y + projection[10] * p.z + projection[11];
+		float iz = (z != 0.f) ? 1.f / z : 1.f;
+		x *= iz;
+		y *= iz;
+
+		if (!distort) {
+			return cv::Point2f(fx * x + px, fy * y + py);
+		}
+
+		// radial (k1, k2) and tangential (p1, p2) distortion
+		float xx = x * x;
+		float yy = y * y;
+		float xy = x * y;
+		float r2 = xx + yy;
+		float radial = 1.f + r2 * (distortion[0] + r2 * distortion[1]);
+		float xd = x * radial + 2.f * distortion[2] * xy + distortion[3] * (r2 + 2.f * xx);
+		float yd = y * radial + distortion[2] * (r2 + 2.f * yy) + 2.f * distortion[3] * xy;
+
+		return cv::Point2f(fx * xd + px, fy * yd + py);
+	}
+
+	void Project(cv::Point3f const* points, cv::Point2f* pixels, int count, bool distort = true) const;
+
 	// functions for 2D <=> 3D calculation
-	cv::Point3f Point2DtoWorld3D(cv::Point);
+	cv::Point3f Point2DtoWorld3D(cv::Point) const;
+	void Point2DtoWorld3D(cv::Point const* pts, cv::Point3f* worldPts, int count) const;
+
+	// undistortion tables, loaded from the cache file if it matches the calibration; the remap tables
+	// for undistorting masks are only built when asked for, the ray table always
+	void InitUndistortion(std::string const& cacheFile = "", bool remapTables = false);
+	void UndistortMask(cv::Mat const& mask, cv::Mat& undistorted) const;
+
+	// region of the (distorted) view covered by the acquisition volume, from its 8 corners
+	void InitVolumeRegion(std::vector<cv::Point3f> const& corners);
 
 private:
-	cv::Point3f camPoint3DtoWorld3D(cv::Point3f camPt3D);
+	void cacheProjection();
+	cv::Vec3f translation() const;
+	cv::Point3f camPoint3DtoWorld3D(cv::Point3f camPt3D) const;
+
+	bool loadUndistortion(std::string const& cacheFile, bool remapTables);
+	void saveUndistortion(std::string const& cacheFile) const;
 
 public:
 	cv::Mat Foreground;
+	bool UndistortForeground; // the foreground mask is undistorted (look-up tables use the ideal projection)
 	std::vector<cv::Point3f> Corners;
 
+	// per row, the columns covered by the acquisition volume (an empty range if none), and their bounding box
+	std::vector<cv::Range> VolumeSpans;
+	cv::Rect VolumeBounds;
+
 	// camera location
 	cv::Point3f PosWorld; // 3D coordinates in world frame
 
@@ -47,15 +94,26 @@ private:
 	cv::Mat translationVector;
 	cv::Mat intrinsicMatrix;
 	cv::Mat distortionCoeffs;
-	cv::Mat rotationMatrix;
+	cv::Matx33f rotationMatrix;
 
 	// Rt matrix and its inverse
-	cv::Mat Rt;
-	cv::Mat inverseRt;
+	cv::Matx44f Rt;
+	cv::Matx44f inverseRt;
 
 	// camera focal length and principal points
 	float fx;
 	float fy;
 	float px;
 	float py;
+
+	// cached [R|t] projection onto the normalized image plane (row-major 3x4) and k1, k2, p1, p2
+	float projection[12];
+	float distortion[4];
+
+	// remap tables from the undistorted to the distorted view (fixed-point, for cv::remap)
+	cv::Mat undistortMap1;
+	cv::Mat undistortMap2;
+
+	// undistorted normalized image coordinates of every pixel (CV_32FC2)
+	cv::Mat rayTable;
 };
@@ -0,0 +1,157 @@
+#include "DebugWindows.hpp"
+
+#include <opencv2/opencv.hpp>
+
+// window of each debug view, the histograms have two more windows
+static const char* WindowNames[DEBUG_VIEW_COUNT] = { "Video Feed", "Foreground", "Camera Color Histogram" };
+static const char* HistogramWindows[] = { "Camera Color Histogram", "Image Histogram A", "Image Histogram B" };
+
+// time the window thread waits for events in between snapshots
+static const int EventWait = 10;
+
+DebugWindows::DebugWindows(double rate) : running(false) {
+	period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+		std::chrono::duration<double>((rate > 0.0) ? 1.0 / rate : 0.0));
+	next = std::chrono::steady_clock::now();
+
+	for (int view = 0; view < DEBUG_VIEW_COUNT; ++view) {
+		wanted[view] = false;
+		shown[view] = false;
+	}
+}
+
+DebugWindows::~DebugWindows() {
+	Stop();
+}
+
+void DebugWindows::Start() {
+	if (!running) {
+		running = true;
+		thread = std::thread(&DebugWindows::run, this);
+	}
+}
+
+void DebugWindows::Stop() {
+	running = false;
+	if (thread.joinable()) {
+		thread.join();
+	}
+}
+
+void DebugWindows::Toggle(DebugView view) {
+	Show(view, !wanted[view]);
+}
+
+void DebugWindows::Show(DebugView view, bool show) {
+	wanted[view] = show;
+}
+
+int DebugWindows::TakeKey() {
+	std::lock_guard<std::mutex> lock(keysMutex);
+	if (keys.empty()) {
+		return -1;
+	}
+
+	int key = keys.front();
+	keys.pop_front();
+	return key;
+}
+
+bool DebugWindows::Due() {
+	bool open = false;
+	for (int view = 0; view < DEBUG_VIEW_COUNT; ++view) {
+		open = open || wanted[view];
+	}
+
+	auto now = std::chrono::steady_clock::now();
+	if (!open || now < next) {
+		return false;
+	}
+
+	next = now + period;
+	return true;
+}
+
+bool DebugWindows::Wants(DebugView view) const {
+	return wanted[view];
+}
+
+FrameSnapshot& DebugWindows::Back() {
+	return snapshots.Back();
+}
+
+void DebugWindows::Publish() {
+	snapshots.Publish();
+}
+
+void DebugWindows::run() {
+	while (running) {
+		// open and close the windows as asked, a window closed by the user is not opened again
+		for (int view = 0; view < DEBUG_VIEW_COUNT; ++view) {
+			char const* name = WindowNames[view];
+
+			if (shown[view] && cv::getWindowProperty(name, cv::WND_PROP_VISIBLE) < 1) {
+				wanted[view] = false;
+			}
+
+			if (wanted[view] && !shown[view]) {
+				if (view == DEBUG_HISTOGRAMS) {
+					for (char const* window : HistogramWindows) {
+						cv::namedWindow(window, cv::WINDOW_AUTOSIZE);
+					}
+				}
+				else {
+					cv::namedWindow(name, cv::WINDOW_AUTOSIZE);
+				}
+				shown[view] = true;
+			}
+			else if (!wanted[view] && shown[view]) {
+				if (view == DEBUG_HISTOGRAMS) {
+					for (char const* window : HistogramWindows) {
+						cv::destroyWindow(window);
+					}
+				}
+				else {
+					cv::destroyWindow(name);
+				}
+				shown[view] = false;
+			}
+		}
+
+		// show the latest snapshot
+		if (snapshots.Update()) {
+			FrameSnapshot const& snapshot = snapshots.Front();
+
+			if (shown[DEBUG_VIDEO] && !snapshot.Frame.empty()) {
+				cv::imshow(WindowNames[DEBUG_VIDEO], snapshot.Frame);
+			}
+			if (shown[DEBUG_FOREGROUND] && !snapshot.Foreground.empty()) {
+				cv::imshow(WindowNames[DEBUG_FOREGROUND], snapshot.Foreground);
+			}
+			if (shown[DEBUG_HISTOGRAMS] && snapshot.HasHistograms) {
+				cv::imshow(HistogramWindows[0], snapshot.ColorHistogram);
+				cv::imshow(HistogramWindows[1], snapshot.ImageHistogramA);
+				cv::imshow(HistogramWindows[2], snapshot.ImageHistogramB);
+			}
+		}
+
+		// handle the window events, keys go to the main thread
+		bool open = false;
+		for (int view = 0; view < DEBUG_VIEW_COUNT; ++view) {
+			open = open || shown[view];
+		}
+
+		if (open) {
+			int key = cv::waitKey(EventWait);
+			if (key >= 0) {
+				std::lock_guard<std::mutex> lock(keysMutex);
+				keys.push_back(key & 0xff);
+			}
+		}
+		else {
+			std::this_thread::sleep_for(std::chrono::milliseconds(EventWait));
+		}
+	}
+
+	cv::destroyAllWindows();
+}
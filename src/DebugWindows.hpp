@@ -0,0 +1,56 @@
+#pragma once
+
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "TripleBuffer.hpp"
+#include "FrameSnapshot.hpp"
+
+// Debug views that can be shown, each in its own window.
+enum DebugView {
+	DEBUG_VIDEO, DEBUG_FOREGROUND, DEBUG_HISTOGRAMS, DEBUG_VIEW_COUNT
+};
+
+// The OpenCV debug windows, run on a thread of their own. The processing thread hands over a
+// snapshot only when a window is open and the last one is older than the refresh period, and
+// never waits for the windows; keys pressed in the windows are queued for the main thread.
+class DebugWindows {
+public:
+	explicit DebugWindows(double rate);
+	~DebugWindows();
+
+public:
+	void Start();
+	void Stop();
+
+	// main thread
+	void Toggle(DebugView);
+	void Show(DebugView, bool show);
+	int TakeKey();						// next key pressed in a debug window, -1 if none
+
+	// processing thread
+	bool Due();							// a new snapshot is wanted, restarts the refresh period
+	bool Wants(DebugView) const;		// the window of the view is open
+	FrameSnapshot& Back();
+	void Publish();
+
+private:
+	void run();
+
+private:
+	std::chrono::steady_clock::duration period;		// minimum time between snapshots
+	std::chrono::steady_clock::time_point next;		// owned by the processing thread
+
+	std::thread thread;
+	std::atomic<bool> running;
+	std::atomic<bool> wanted[DEBUG_VIEW_COUNT];		// windows asked for by the user
+	std::atomic<bool> shown[DEBUG_VIEW_COUNT];		// windows that are currently open
+
+	TripleBuffer<FrameSnapshot> snapshots;
+
+	std::mutex keysMutex;
+	std::deque<int> keys;
+};
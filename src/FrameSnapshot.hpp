@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include <opencv2/opencv.hpp>
+
+// Vertex with a position and an 8-bit color, as stored in the vertex buffers.
+struct ColorVertex {
+	float x;
+	float y;
+	float z;
+	uint8_t r;
+	uint8_t g;
+	uint8_t b;
+	uint8_t a;
+};
+
+// Results of a processed frame, published by the processing thread for rendering and display.
+struct FrameSnapshot {
+	int FrameIndex = -1;
+
+	// visible voxels, ready for rendering
+	std::vector<ColorVertex> Voxels;
+
+	// tracked person positions and the back-projected pixel positions per view
+	cv::Point3f PersonPosA;
+	cv::Point3f PersonPosB;
+	std::vector<cv::Point3f> LinePosWorldA;
+	std::vector<cv::Point3f> LinePosWorldB;
+
+	// debug images of a single view
+	int View = 0;
+	cv::Mat Frame;
+	cv::Mat Foreground;
+
+	// histograms of that view, only when they were asked for
+	bool HasHistograms = false;
+	cv::Mat ColorHistogram;
+	cv::Mat ImageHistogramA;
+	cv::Mat ImageHistogramB;
+};
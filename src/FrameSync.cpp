@@ -0,0 +1,139 @@
+#include "FrameSync.hpp"
+
+#include <cmath>
+#include <utility>
+#include <algorithm>
+
+FrameSync::FrameSync(double fps) : Tolerance(0.5), HoldFrames(5), clock(0.0), started(false) {
+	period = 1000.0 / ((fps > 0.0) ? fps : 25.0);
+}
+
+bool FrameSync::AddVideo(std::string const& path) {
+	streams.push_back(Stream());
+	streams.back().capture.open(path);
+	Status.push_back(FRAME_MISSING);
+	Stats.push_back(StreamStats());
+	return streams.back().capture.isOpened();
+}
+
+void FrameSync::AddRawView(std::shared_ptr<RawFrameReader> raw, int view) {
+	streams.push_back(Stream());
+	streams.back().raw = raw;
+	streams.back().rawView = view;
+	Status.push_back(FRAME_MISSING);
+	Stats.push_back(StreamStats());
+}
+
+// Reads the next frame of a view into its pending frame.
+bool FrameSync::fetch(int view) {
+	Stream& s = streams[view];
+	StreamStats& stats = Stats[view];
+
+	double time = 0.0;
+	if (s.raw) {
+		s.pending = s.raw->Frame(s.rawNext, s.rawView);
+		if (!s.pending.empty()) {
+			time = s.raw->Timestamp(s.rawNext, s.rawView);
+			s.rawNext++;
+		}
+	}
+	else if (s.capture.read(s.pending) && !s.pending.empty()) {
+		time = s.capture.get(cv::CAP_PROP_POS_MSEC);
+	}
+	else {
+		s.pending.release();
+	}
+
+	if (s.pending.empty()) {
+		stats.Failures++;
+		return false;
+	}
+
+	// times that do not advance are replaced by one frame period, gaps of whole periods are drops
+	if (s.hasRead) {
+		if (time <= s.readTime) {
+			time = s.readTime + period;
+		}
+		else if (time - s.readTime > 1.5 * period) {
+			stats.Dropped += static_cast<int>(std::lround((time - s.readTime) / period)) - 1;
+		}
+	}
+
+	s.pendingTime = time;
+	s.readTime = time;
+	s.hasRead = true;
+	s.hasPending = true;
+	stats.Frames++;
+	return true;
+}
+
+bool FrameSync::Read(std::vector<cv::Mat>& frames, double& timestamp) {
+	const int numViews = NumViews();
+	const double tolerance = Tolerance * period;
+
+	// read ahead, frames that arrive after their set was made are too late
+	for (int i = 0; i < numViews; ++i) {
+		Stream& s = streams[i];
+		if (!s.hasPending) {
+			fetch(i);
+		}
+		while (started && s.hasPending && s.pendingTime <= clock + tolerance) {
+			Stats[i].Skipped++;
+			s.hasPending = false;
+			fetch(i);
+		}
+	}
+
+	// the set is made at the earliest frame that is left
+	bool any = false;
+	double time = 0.0;
+	for (Stream const& s : streams) {
+		if (s.hasPending && (!any || s.pendingTime < time)) {
+			time = s.pendingTime;
+			any = true;
+		}
+	}
+	if (!any) {
+		return false;
+	}
+	clock = time;
+	started = true;
+
+	frames.resize(numViews);
+	for (int i = 0; i < numViews; ++i) {
+		Stream& s = streams[i];
+		StreamStats& stats = Stats[i];
+
+		// take the last frame up to the set time, the buffers of the pending and last frames are swapped
+		// so reading does not allocate (the frame of the previous set is overwritten)
+		bool taken = false;
+		while (s.hasPending && s.pendingTime <= clock + tolerance) {
+			if (taken) {
+				stats.Skipped++;
+			}
+			std::swap(s.last, s.pending);
+			s.lastTime = s.pendingTime;
+			s.hasPending = false;
+			taken = true;
+			fetch(i);
+		}
+
+		if (taken) {
+			Status[i] = FRAME_CURRENT;
+			frames[i] = s.last;
+		}
+		else if (!s.last.empty() && clock - s.lastTime <= HoldFrames * period) {
+			Status[i] = FRAME_HELD;
+			frames[i] = s.last;
+			stats.Held++;
+		}
+		else {
+			Status[i] = FRAME_MISSING;
+			frames[i] = cv::Mat();
+			stats.Missing++;
+		}
+	}
+
+	timestamp = clock;
+	return true;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "RawFrames.hpp"
+
+// Where the frame of a view in a frame set comes from.
+enum FrameStatus {
+	FRAME_CURRENT,		// captured within the tolerance of the frame set time
+	FRAME_HELD,			// the view had no frame for this set, its last frame is used again
+	FRAME_MISSING		// the view had no frame for longer than the hold time (the frame is empty)
+};
+
+// Synchronization counts of a single view.
+struct StreamStats {
+	int Frames = 0;		// frames read
+	int Dropped = 0;	// frames missing in the stream, judging by the gaps between the capture times
+	int Skipped = 0;	// frames read but left out, because a later frame was closer to the set time
+	int Held = 0;		// frame sets that used the last frame again
+	int Missing = 0;	// frame sets without a frame of this view
+	int Failures = 0;	// reads that returned no frame
+};
+
+/**
+ * 		Reads the views in step and groups their frames into frame sets by capture time.
+ *
+ * 		Every view reads one frame ahead. The time of a frame set is the capture time of the earliest
+ * 		frame that has not been used yet; every view then takes its last frame captured no later than
+ * 		that time plus the tolerance, and the frames before it are skipped. A view without such a frame
+ * 		(a dropped frame or a stalled camera) holds its last frame for up to HoldFrames frame periods,
+ * 		after which it is reported missing until it delivers frames again. Frames that arrive after
+ * 		the set they belong to was made are skipped. Reading ends when no view has a frame left.
+ *
+ * 		Capture times come from the sources; a source whose times do not advance (a camera without
+ * 		timestamps) is given one frame period per frame.
+ */
+class FrameSync {
+public:
+	FrameSync(double fps);
+
+public:
+	bool AddVideo(std::string const& path);						// video file or camera stream
+	void AddRawView(std::shared_ptr<RawFrameReader>, int view);	// view of a raw frame file
+
+	bool Read(std::vector<cv::Mat>& frames, double& timestamp);	// next frame set and its time in milliseconds
+
+	int NumViews() const { return static_cast<int>(streams.size()); }
+
+public:
+	double Tolerance;	// frames within this many frame periods of the set time belong to the set
+	int HoldFrames;		// number of frame periods a view's last frame may be held
+
+	std::vector<FrameStatus> Status;	// of each view in the last frame set
+	std::vector<StreamStats> Stats;
+
+private:
+	struct Stream {
+		cv::VideoCapture capture;
+		std::shared_ptr<RawFrameReader> raw;
+		int rawView = 0;
+		int rawNext = 0;
+
+		cv::Mat pending;			// next frame, read ahead
+		double pendingTime = 0.0;
+		bool hasPending = false;
+
+		cv::Mat last;				// last frame taken into a set
+		double lastTime = 0.0;
+
+		double readTime = 0.0;		// capture time of the last frame read
+		bool hasRead = false;
+	};
+
+	bool fetch(int view);
+
+private:
+	std::vector<Stream> streams;
+
+	double period;		// frame period in milliseconds
+	double clock;		// time of the last frame set
+	bool started;
+};
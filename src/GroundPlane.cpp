@@ -0,0 +1,96 @@
+#include "GroundPlane.hpp"
+
+#include <algorithm>
+
+#include <opencv2/opencv.hpp>
+
+#include "Main.hpp"
+#include "VoxelGrid.hpp"
+
+GroundPlane::GroundPlane() : MinColumnVoxels(2), MinCells(8), MaxDistance(1000.f) {
+}
+
+void GroundPlane::Detect(VoxelGrid const& grid) {
+	Blobs.clear();
+
+	cv::compare(grid.groundOccupancy, MinColumnVoxels, occupied, cv::CMP_GE);
+	int numLabels = cv::connectedComponentsWithStats(occupied, labels, stats, centroids, 8, CV_32S);
+
+	// weighted sums per label, label 0 is the empty ground
+	std::vector<double> sumX(numLabels, 0.0);
+	std::vector<double> sumY(numLabels, 0.0);
+	std::vector<int> voxels(numLabels, 0);
+	std::vector<int> heights(numLabels, 0);
+	for (int row = 0; row < labels.rows; ++row) {
+		int const* labelRow = labels.ptr<int>(row);
+		uint16_t const* countRow = grid.groundOccupancy.ptr<uint16_t>(row);
+		uint16_t const* heightRow = grid.groundHeight.ptr<uint16_t>(row);
+		for (int col = 0; col < labels.cols; ++col) {
+			int label = labelRow[col];
+			if (label == 0) {
+				continue;
+			}
+			sumX[label] += static_cast<double>(countRow[col]) * row;
+			sumY[label] += static_cast<double>(countRow[col]) * col;
+			voxels[label] += countRow[col];
+			heights[label] = std::max(heights[label], static_cast<int>(heightRow[col]));
+		}
+	}
+
+	// cell (row, col) covers x from originX + row * size and y from originY + col * size
+	float size = castf(grid.voxelSize);
+	float originX = castf(grid.voxels[0].x);
+	float originY = castf(grid.voxels[0].y);
+
+	for (int label = 1; label < numLabels; ++label) {
+		int cells = stats.at<int>(label, cv::CC_STAT_AREA);
+		if (cells < MinCells || voxels[label] == 0) {
+			continue;
+		}
+
+		GroundBlob blob;
+		blob.Position = cv::Point2f(
+			originX + size * castf(sumX[label] / voxels[label] + 0.5),
+			originY + size * castf(sumY[label] / voxels[label] + 0.5));
+		blob.Bounds = cv::Rect(
+			casti(originX + size * stats.at<int>(label, cv::CC_STAT_TOP)),
+			casti(originY + size * stats.at<int>(label, cv::CC_STAT_LEFT)),
+			casti(size * stats.at<int>(label, cv::CC_STAT_HEIGHT)),
+			casti(size * stats.at<int>(label, cv::CC_STAT_WIDTH)));
+		blob.Cells = cells;
+		blob.Voxels = voxels[label];
+		blob.Height = heights[label];
+		Blobs.push_back(blob);
+	}
+}
+
+// Greedy nearest-neighbour association: the closest target-blob pair is assigned first.
+void GroundPlane::Associate(std::vector<cv::Point2f> const& targets) {
+	Assigned.assign(targets.size(), -1);
+	std::vector<bool> taken(Blobs.size(), false);
+
+	for (size_t round = 0; round < targets.size(); ++round) {
+		float best = MaxDistance;
+		int bestTarget = -1;
+		int bestBlob = -1;
+		for (size_t t = 0; t < targets.size(); ++t) {
+			if (Assigned[t] >= 0) {
+				continue;
+			}
+			for (size_t b = 0; b < Blobs.size(); ++b) {
+				float distance = castf(cv::norm(Blobs[b].Position - targets[t]));
+				if (!taken[b] && distance < best) {
+					best = distance;
+					bestTarget = casti(t);
+					bestBlob = casti(b);
+				}
+			}
+		}
+
+		if (bestTarget < 0) {
+			break;
+		}
+		Assigned[bestTarget] = bestBlob;
+		taken[bestBlob] = true;
+	}
+}
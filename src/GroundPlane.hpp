@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+class VoxelGrid;
+
+// Group of occupied cells in the top-down occupancy map of the voxel grid.
+struct GroundBlob {
+	cv::Point2f Position;	// center of the blob, weighted by the voxels above each cell, in millimeters
+	cv::Rect Bounds;		// extent on the ground plane in millimeters
+	int Cells = 0;			// number of occupied cells
+	int Voxels = 0;			// number of voxels above them
+	int Height = 0;			// top of the highest voxel in millimeters
+};
+
+// Blob detection and target association on the ground plane. Works on the occupancy map
+// (VoxelGrid::groundOccupancy) instead of the voxels, which keeps it far cheaper than the 3D
+// stages; maps of several reconstructions can be merged by adding them cell by cell.
+class GroundPlane {
+public:
+	GroundPlane();
+
+public:
+	void Detect(VoxelGrid const&);								// finds the blobs in the occupancy map
+	void Associate(std::vector<cv::Point2f> const& targets);	// assigns the blobs to the targets
+
+public:
+	int MinColumnVoxels;	// cells with fewer voxels above them are empty
+	int MinCells;			// smaller blobs are dropped as noise
+	float MaxDistance;		// targets further than this from every blob stay unassigned, in millimeters
+
+	std::vector<GroundBlob> Blobs;
+	std::vector<int> Assigned;		// blob of each target, -1 if none
+
+private:
+	cv::Mat occupied;
+	cv::Mat labels;
+	cv::Mat stats;
+	cv::Mat centroids;
+};
@@ -1,50 +1,102 @@
 #include "Histogram.hpp"
 
+#include <cmath>
+#include <cfloat>
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <algorithm>
+
 #include "Main.hpp"
 
-// Generates RGB histograms based on an image.
-void Histogram::CreateColorHistogram(cv::Mat image, cv::Mat mask) {
-	// split image into RGB channels
-	std::vector<cv::Mat> channels;
-	cv::split(image, channels);
+Histogram::Histogram() : version(0), renderedVersion(0) {
+}
+
+// bin of every 8-bit value, computed at compile time
+static constexpr std::array<uint8_t, 256> makeRangeBins() {
+	std::array<uint8_t, 256> bins{};
+	for (int value = 0; value < 256; ++value) {
+		bins[value] = static_cast<uint8_t>(Histogram::RangeBin(static_cast<uint8_t>(value)));
+	}
+	return bins;
+}
 
+static constexpr std::array<uint8_t, 256> RangeBins = makeRangeBins();
+
+static_assert(RangeBins[4] == NUM_BINS && RangeBins[5] == 0 && RangeBins[249] == NUM_BINS - 1 && RangeBins[250] == NUM_BINS,
+	"really dark and really bright values are filtered");
+
+// Generates RGB histograms based on an 8-bit, 3 channel image, counting only the pixels under the mask (if any).
+void Histogram::CreateColorHistogram(cv::Mat image, cv::Mat mask) {
 	// clear previous values
 	Reset();
 
-	// calculate new values
-	int histSize = NUM_BINS;
-	float range[] = { 5, 250 }; // filter realy dark and really bright values
-	const float* histRange = { range };
+	if (image.type() != CV_8UC3 || (!mask.empty() && (mask.type() != CV_8U || mask.size() != image.size()))) {
+		std::cerr << "Color histograms need an 8-bit color image and mask" << std::endl;
+		return;
+	}
+
+	// consecutive pixels are counted in separate sub-histograms, so increments of the same bin do
+	// not wait for each other
+	const int lanes = 4;
+	uint32_t counts[lanes][3][NUM_BINS + 1] = {};
+	std::array<uint8_t, 256> const& bins = RangeBins;
+
+	for (int y = 0; y < image.rows; ++y) {
+		uint8_t const* pixel = image.ptr<uint8_t>(y);
+		uint8_t const* inside = mask.empty() ? nullptr : mask.ptr<uint8_t>(y);
+
+		for (int x = 0; x < image.cols; ++x, pixel += 3) {
+			if (inside && !inside[x]) {
+				continue;
+			}
+
+			uint32_t (&lane)[3][NUM_BINS + 1] = counts[x & (lanes - 1)];
+			lane[0][bins[pixel[0]]]++;
+			lane[1][bins[pixel[1]]]++;
+			lane[2][bins[pixel[2]]]++;
+		}
+	}
 
-	cv::calcHist(&channels[0], 1, 0, cv::Mat(), hist(0), 1, &histSize, &histRange);
-	cv::calcHist(&channels[1], 1, 0, cv::Mat(), hist(1), 1, &histSize, &histRange);
-	cv::calcHist(&channels[2], 1, 0, cv::Mat(), hist(2), 1, &histSize, &histRange);
+	// merge the sub-histograms, leaving out the filtered values
+	for (int ch = 0; ch < 3; ++ch) {
+		Hist::Bins& values = hist(ch);
+		for (int bin = 0; bin < NUM_BINS; ++bin) {
+			values[bin] = static_cast<float>(counts[0][ch][bin] + counts[1][ch][bin] + counts[2][ch][bin] + counts[3][ch][bin]);
+		}
+	}
 
 	// normalize histogram
 	Normalize();
+	version++;
 }
 
 // Creates an image representation of a histogram.
-cv::Mat Histogram::GetRenderedImage() {
+cv::Mat Histogram::GetRenderedImage() const {
 	cv::Size renderSize = cv::Size(
 		NUM_BINS * HIST_SCALE, 
 		NUM_BINS * HIST_SCALE
 	);
 
-	// initialize render image
-	render = (render.empty()) ? cv::Mat(renderSize, CV_8U) : cv::Mat::zeros(renderSize, CV_8U);
+	// the bins did not change since they were drawn
+	if (!render.empty() && renderedVersion == version) {
+		return render;
+	}
+	renderedVersion = version;
+
+	// initialize render image, a new one so earlier renders handed out stay as they are
+	render = cv::Mat::zeros(renderSize, CV_8U);
 
 	// process each channel individually
 	for (int ch = 0; ch < 3; ++ch) {
 		// determine max
-		double max;
-		cv::minMaxLoc(hist(ch), nullptr, &max, nullptr, nullptr);
+		double max = *std::max_element(hist(ch).begin(), hist(ch).end());
 
 		// draw lines between bin values
 		for (int i = 0; i < NUM_BINS - 1; ++i) {
 			// compute line between two values
-			float currentValue = hist(ch).at<float>(i);
-			float nextValue = hist(ch).at<float>(i+1);
+			float currentValue = hist(ch)[i];
+			float nextValue = hist(ch)[i+1];
 
 			// compute line locations in the image (requires some scaling)
 			double y = (NUM_BINS - ((currentValue * NUM_BINS) / max)) * HIST_SCALE;
@@ -63,36 +115,41 @@ cv::Mat Histogram::GetRenderedImage() {
 	return render;
 }
 
-// Normalizes the histograms for all three channels.
+// Normalizes the histograms for all three channels (L1, each channel sums to the factor).
 void Histogram::Normalize(double factor) {
-	cv::normalize(hist(0), hist(0), factor, cv::NORM_L1);
-	cv::normalize(hist(1), hist(1), factor, cv::NORM_L1);
-	cv::normalize(hist(2), hist(2), factor, cv::NORM_L1);
+	for (Hist::Bins& bins : hist.m) {
+		double sum = 0.0;
+		for (float value : bins) {
+			sum += std::abs(value);
+		}
+
+		float scale = (sum > DBL_EPSILON) ? static_cast<float>(factor / sum) : 0.f;
+		for (float& value : bins) {
+			value *= scale;
+		}
+	}
+	version++;
 }
 
 // Resets all the histograms for all three channels
 void Histogram::Reset() {
-	hist(0).zeros(hist(0).size(), CV_8U);
-	hist(1).zeros(hist(1).size(), CV_8U);
-	hist(2).zeros(hist(2).size(), CV_8U);
+	for (Hist::Bins& bins : hist.m) {
+		bins.fill(0.f);
+	}
+	version++;
 }
 
 // Returns the mean of the channel histogram peaks.
-cv::Point Histogram::GetMeanPeakPosition() {
-	cv::Point maxR, maxG, maxB;
-	
-	// retrieve individual channel peaks
-	cv::minMaxLoc(hist.r(), nullptr, nullptr, nullptr, &maxR);
-	cv::minMaxLoc(hist.g(), nullptr, nullptr, nullptr, &maxG);
-	cv::minMaxLoc(hist.b(), nullptr, nullptr, nullptr, &maxB);
+cv::Point Histogram::GetMeanPeakPosition() const {
+	// retrieve individual channel peaks (the first bin of each maximum)
+	int maxR = casti(std::max_element(hist(0).begin(), hist(0).end()) - hist(0).begin());
+	int maxG = casti(std::max_element(hist(1).begin(), hist(1).end()) - hist(1).begin());
+	int maxB = casti(std::max_element(hist(2).begin(), hist(2).end()) - hist(2).begin());
 	
-	// calculate mean of x
-	return cv::Point(static_cast<int>(maxR.x + maxG.x + maxB.x / 3.0), 0);
+	// calculate mean of the bins
+	return cv::Point(static_cast<int>((maxR + maxG + maxB) / 3.0), 0);
 }
 
-// Adds values to the selected bin for each channel.
-void Histogram::AddValues(int bin, float valR, float valG, float valB) {
-	hist.r().at<float>(bin) = hist.r().at<float>(bin) + valR;
-	hist.g().at<float>(bin) = hist.g().at<float>(bin) + valG;
-	hist.b().at<float>(bin) = hist.b().at<float>(bin) + valB;
+cv::Mat Histogram::Channel(int ch) const {
+	return cv::Mat(NUM_BINS, 1, CV_32F, const_cast<float*>(hist(ch).data()));
 }
@@ -1,38 +1,69 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
+
 #include <opencv2/opencv.hpp>
 
-enum Channel { 
+#include "Main.hpp"
+
+enum Channel {
 	CHANNEL_RED, CHANNEL_GREEN, CHANNEL_BLUE
 };
 
+// Bins of the three channels, stored in place.
 struct Hist {
-	std::vector<cv::Mat> m;
-	cv::Mat r() { return m[0]; }
-	cv::Mat g() { return m[1]; }
-	cv::Mat b() { return m[2]; }
-	cv::Mat operator()(int ch) { return m[ch]; }
+	using Bins = std::array<float, NUM_BINS>;
+
+	std::array<Bins, 3> m{};
+	Bins& r() { return m[0]; }
+	Bins& g() { return m[1]; }
+	Bins& b() { return m[2]; }
+	Bins& operator()(int ch) { return m[ch]; }
+	Bins const& operator()(int ch) const { return m[ch]; }
 };
 
 class Histogram {
 private:
 	Hist hist;
+	uint64_t version;					// changes whenever the bins change
+
 	mutable cv::Mat render;
+	mutable uint64_t renderedVersion;	// version of the bins in the render image
 
 public: // constructor
-	Histogram() = default;
+	Histogram();
 
 public: // functions
 	void CreateColorHistogram(cv::Mat image, cv::Mat mask = cv::Mat());
 	void Normalize(double factor = 1.0);
 	void Reset();
-	
-	cv::Mat GetRenderedImage();
-	cv::Point GetMeanPeakPosition();
-	
-	inline float R(int bin) { return hist.r().at<float>(bin); }
-	inline float G(int bin) { return hist.g().at<float>(bin); }
-	inline float B(int bin) { return hist.b().at<float>(bin);}
-
-	void AddValues(int bin, float valR, float valG, float valB);
+
+	cv::Mat GetRenderedImage() const;	// only redrawn when the bins changed since the last call
+	inline uint64_t Version() const { return version; }
+	cv::Point GetMeanPeakPosition() const;
+
+	// bins of a channel as a single column matrix, without copying (valid as long as the histogram)
+	cv::Mat Channel(int ch) const;
+
+	inline float R(int bin) const { return hist.m[0][bin]; }
+	inline float G(int bin) const { return hist.m[1][bin]; }
+	inline float B(int bin) const { return hist.m[2][bin]; }
+
+	// the version is left alone here, per value; filling ends with Normalize, which changes it
+	inline void AddValues(int bin, float valR, float valG, float valB) {
+		hist.m[0][bin] += valR;
+		hist.m[1][bin] += valG;
+		hist.m[2][bin] += valB;
+	}
+
+	// bin of a color value when the whole color depth is binned
+	static constexpr int ColorBin(uint8_t value) {
+		return value / (COLOR_DEPTH / NUM_BINS);
+	}
+
+	// bin of a color value when only [5, 250) is binned (as CreateColorHistogram does), NUM_BINS outside that range
+	static constexpr int RangeBin(uint8_t value) {
+		return (value >= 5 && value < 250) ? (value - 5) * NUM_BINS / 245 : NUM_BINS;
+	}
 };
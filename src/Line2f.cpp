@@ -29,13 +29,13 @@ cv::Point2f Line2f::FindIntersection(Line2f& l1, Line2f& l2) {
 }
 
 // Finds all intersections between non-repeating combinations of the given array of lines.
-std::vector<cv::Point2f> Line2f::FindIntersections(Line2f* lines) {
+std::vector<cv::Point2f> Line2f::FindIntersections(std::vector<Line2f>& lines) {
 	std::vector<cv::Point2f> intersections;
 	
-	// find all intersection points (no repetition), we explicitly leave out the 4th view because it is so noisy.
-	for (int i = 1; i < 4; ++i) {
-		for (int j = i; j < 3; ++j) {
-			intersections.push_back(FindIntersection(lines[i-1], lines[j]));
+	// find all intersection points (no repetition)
+	for (size_t i = 0; i < lines.size(); ++i) {
+		for (size_t j = i + 1; j < lines.size(); ++j) {
+			intersections.push_back(FindIntersection(lines[i], lines[j]));
 		}
 	}
 	
@@ -43,7 +43,7 @@ std::vector<cv::Point2f> Line2f::FindIntersections(Line2f* lines) {
 }
 
 // Finds the mean of intersections between several lines.
-cv::Point2f Line2f::FindMeanIntersection(Line2f* lines) {
+cv::Point2f Line2f::FindMeanIntersection(std::vector<Line2f>& lines) {
 	// retrieve non-repeating combinations of intersections between the lines
 	std::vector<cv::Point2f> intersections = FindIntersections(lines);
 	
@@ -14,8 +14,8 @@ public: // constructor
 
 public: // functions
 	static cv::Point2f FindIntersection(Line2f& l1, Line2f& l2);
-	static std::vector<cv::Point2f> FindIntersections(Line2f* lines);
-	static cv::Point2f FindMeanIntersection(Line2f* lines);
+	static std::vector<cv::Point2f> FindIntersections(std::vector<Line2f>& lines);
+	static cv::Point2f FindMeanIntersection(std::vector<Line2f>& lines);
 	
 	static Line2f Line2DFrom3D(cv::Point3f p0, cv::Point3f p1);
 };
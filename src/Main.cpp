@@ -1,11 +1,22 @@
 #include "Main.hpp"
 
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <algorithm>
+
 #include <GL/freeglut.h>
 #include <opencv2/opencv.hpp>
 
+#include "Scene.hpp"
 #include "Camera.hpp"
+#include "Pipeline.hpp"
 #include "Renderer.hpp"
 #include "VoxelGrid.hpp"
+#include "TripleBuffer.hpp"
+#include "DebugWindows.hpp"
+#include "FrameSnapshot.hpp"
 
 #include "Tracker.hpp"
 #include "Histogram.hpp"
@@ -17,8 +28,8 @@ static int mouse_y;
 static bool mouse_left_down;
 static bool mouse_right_down;
 
-// window
-static int currentWindow = 0;
+// window (read by the processing thread)
+static std::atomic<int> currentWindow = 0;
 
 // switches
 static bool topView = false;
@@ -28,92 +39,70 @@ static bool videoEnd = false;
 static bool showLines = true;
 static bool showBoxes = true;
 
-// OpenCV
-static std::vector<cv::Mat> gFrames;
-static std::vector<cv::Mat> gBackgrounds;
-static std::vector<cv::Mat> gBackgroundsHSV;
-static std::vector<cv::Mat> gForegrounds;
-static std::vector<cv::Mat> gForegroundMasks;
-static std::vector<cv::VideoCapture> gCaptures;
-
 // classes
-static std::shared_ptr<Tracker> gTracker;
 static std::shared_ptr<Renderer> gRenderer;
-static std::shared_ptr<VoxelGrid> gVoxelGrid;
-static std::vector<std::shared_ptr<Camera>> gCameras;
-static std::vector<std::shared_ptr<Histogram>> gHistograms;
-
-static cv::Mat getFG(cv::Mat& fgFrame, cv::Mat& bgFrame) {
-	cv::Mat bgOut;
-	//// define temporary parameters
-	//cv::Size size = fgFrame.size(); // size of frame
-
-	//cv::Mat bgOut = cv::Mat(size, CV_8U, 1);
-	//cv::Mat bgTemp = cv::Mat(size, CV_8U, 1);
-	//cv::Mat fgTemp = cv::Mat(size, CV_8U, 1);
-
-	//// Colour transformation from rgb to hsv for the background model
-	//// -> this part could also be outside this function because now it is performed for every new
-	////		frame, while it only has to be done once the background frame is captured!
-
-	////IplImage* b_HSV = cvCreateImage( sz, 8, 3);	// definition and allocation
-	////cvCvtColor(BGframe,b_HSV,CV_BGR2HSV);	// color conversion
-	//std::vector<cv::Mat> bgChannels;
-	//cv::split(bgFrame, bgChannels);
-
-	//// Colour transformation from rgb to hsv for the current frame
-	//cv::Mat fgHSV = fgFrame.clone();
-	//cv::cvtColor(fgFrame, fgHSV, cv::COLOR_BGR2HSV); // color conversion
-
-	//std::vector<cv::Mat> fgChannels;
-	//cv::split(fgHSV, fgChannels);
-
-	//// Definition of the thresholds
-	//int thresholdH = 25;
-	//int thresholdS = 40;
-	//int thresholdV = 65;
-
-	//double maxval = 255.0;
-
-	//// BACKGROUND SUBTRACTION
-
-	//// initialize background by h-channel
-	//cv::absdiff(fgChannels[0], bgChannels[0], fgTemp);
-	//cv::threshold(fgTemp, bgOut, thresholdH, maxval, cv::THRESH_BINARY);
-
-	//// update background by s-channel
-	//cv::absdiff(fgChannels[1], bgChannels[1], fgTemp);
-	//cv::threshold(fgTemp, bgTemp, thresholdS, maxval, cv::THRESH_BINARY);
-	//cv::bitwise_and(bgOut, bgTemp, bgOut);
-
-	//// update background by v-channel
-	//cv::absdiff(fgChannels[2], bgChannels[2], fgTemp);
-	//cv::threshold(fgTemp, bgTemp, thresholdV, maxval, cv::THRESH_BINARY);
-	//cv::bitwise_or(bgOut, bgTemp, bgOut);
+static std::shared_ptr<Pipeline> gPipeline;
+
+// processing runs on its own thread and publishes a snapshot of every processed frame;
+// the GLUT thread only draws the latest snapshot
+static std::thread gProcessing;
+static std::atomic<bool> gProcessingRunning = false;
+static std::atomic<bool> gProcessingEnded = false;
+static TripleBuffer<FrameSnapshot> gSnapshots;
+static int gShownFrame = -1;
+
+// the OpenCV windows of the debug views, off until asked for
+static std::shared_ptr<DebugWindows> gDebug;
+
+static const char* Keys =
+	"{help h     |     | print this message }"
+	"{@scene     |     | scene description (default: the recorded data set in data/) }"
+	"{debug      |     | debug views to open: any of video, foreground and histograms, separated by commas }"
+	"{debug_rate | 10  | refresh rate of the debug views in Hz }";
+
+// minimum time between processed frames (one frame period of the scene), to play the videos at their recorded speed
+static std::chrono::steady_clock::duration gFramePeriod;
+
+static void process() {
+	auto next = std::chrono::steady_clock::now();
+
+	while (gProcessingRunning) {
+		// process the next frame from the videos
+		if (!gPipeline->Update()) {
+			gProcessingEnded = true;
+			return;
+		}
 
-	//// erosion kernel
-	//cv::Mat element_d = cv::getStructuringElement(cv::MorphShapes::MORPH_CROSS, cv::Size2f(5, 5), cv::Point(3, 3)); // CV_SHAPE_CROSS CV_SHAPE_RECT CV_SHAPE_ELLIPSE
+		gPipeline->Snapshot(gSnapshots.Back(), -1);
+		gSnapshots.Publish();
 
-	//// Erosion & dilation to connect blobs and remove noisy points
-	//cv::erode(bgOut, bgOut, 0);
-	//cv::dilate(bgOut, bgOut, element_d, cv::Point(-1, -1), 2);
-	//cv::erode(bgOut, bgOut, 0);
+		// the debug views only get a snapshot (with images) at their own rate
+		if (gDebug->Due()) {
+			gPipeline->Snapshot(gDebug->Back(), currentWindow, gDebug->Wants(DEBUG_VIDEO), gDebug->Wants(DEBUG_FOREGROUND),
+				gDebug->Wants(DEBUG_HISTOGRAMS));
+			gDebug->Publish();
+		}
 
-	return bgOut;
+		next = std::max(next + gFramePeriod, std::chrono::steady_clock::now());
+		std::this_thread::sleep_until(next);
+	}
 }
 
 static void display() {
+	gSnapshots.Update();
+	FrameSnapshot const& snapshot = gSnapshots.Front();
+
 	// render scene
-	gRenderer->Render(gVoxelGrid);
+	gRenderer->Render(snapshot);
 	
 	// draw lines from camera into scene
 	if (showLines) {
-		gTracker->LabelLines();
+		gPipeline->PersonTracker->LabelLines(snapshot.LinePosWorldA, snapshot.LinePosWorldB);
 	}
 
 	// draw label grid in the scene
 	if (showBoxes) {
-		gTracker->LabelGrids();
+		gPipeline->PersonTracker->LabelGrids(snapshot.PersonPosA, snapshot.PersonPosB);
 	}
 	
 	// swap buffers
@@ -121,7 +110,12 @@ static void display() {
 }
 
 static void quit() {
-	cv::destroyAllWindows();
+	gProcessingRunning = false;
+	if (gProcessing.joinable()) {
+		gProcessing.join();
+	}
+
+	gDebug->Stop();
 	exit(0);
 }
 
@@ -178,6 +172,18 @@ static void keyboard(unsigned char key, int x, int y) {
 		case 'b':
 			showBoxes = !showBoxes;
 			break;
+
+		case 'i':
+			gDebug->Toggle(DEBUG_VIDEO);
+			break;
+
+		case 'f':
+			gDebug->Toggle(DEBUG_FOREGROUND);
+			break;
+
+		case 'h':
+			gDebug->Toggle(DEBUG_HISTOGRAMS);
+			break;
 	}
 }
 
@@ -220,37 +226,18 @@ static void reshape(int width, int height) {
 }
 
 static void update(int value = 0) {
-	// get frame from videos
-	for (int i = 0; i < NumViews; ++i) {
-		gCaptures[i].read(gFrames[i]);
-
-		if (gFrames[i].empty()) {
-			quit();
-		}
-
-		gForegroundMasks[i] = getFG(gFrames[i], gBackgroundsHSV[i]);
-		gCameras[i]->Foreground = gForegroundMasks[i];
-
-		gHistograms[i]->CreateColorHistogram(gFrames[i], gForegroundMasks[i]);
-		gForegrounds[i] = gTracker->ExtractForeground(gFrames[i], gForegroundMasks[i]);
+	if (gProcessingEnded) {
+		quit();
 	}
 
-	gRenderer->NumFrames++;
-	gVoxelGrid->UpdateVoxels(gCameras);
-
-	// find the persons in the 3D grid
-	gTracker->TrackPersons(gForegrounds, NumViews);
-
-	// label persons
-	gTracker->LabelVoxels(gVoxelGrid, gTracker->PersonPosA, 350.f, 750.f, CV_RGB(0, 200, 0));
-	gTracker->LabelVoxels(gVoxelGrid, gTracker->PersonPosB, 350.f, 750.f, CV_RGB(0, 0, 200));
+	// count the processed frames
+	gSnapshots.Update();
+	FrameSnapshot const& snapshot = gSnapshots.Front();
 
-	cv::imshow("Video Feed", gFrames[currentWindow]);
-	cv::imshow("Foreground", gForegrounds[currentWindow]);
-	
-	cv::imshow("Camera Color Histogram", gHistograms[currentWindow]->GetRenderedImage());
-	cv::imshow("Image Histogram A", gTracker->GetImageHistogramA(currentWindow).GetRenderedImage());
-	cv::imshow("Image Histogram B", gTracker->GetImageHistogramB(currentWindow).GetRenderedImage());
+	if (snapshot.FrameIndex != gShownFrame) {
+		gShownFrame = snapshot.FrameIndex;
+		gRenderer->NumFrames++;
+	}
 
 	if (topView) {
 		gRenderer->ViewIndex(currentWindow);
@@ -269,17 +256,13 @@ static void update(int value = 0) {
 		gRenderer->RotateView();
 	}
 
-	char key = cv::waitKey(2);
-	keyboard(key, 0, 0);
+	// keys pressed in the debug windows
+	for (int key = gDebug->TakeKey(); key >= 0; key = gDebug->TakeKey()) {
+		keyboard(static_cast<unsigned char>(key), 0, 0);
+	}
 
 	glutSwapBuffers();
 
-	// clean up
-	for (int i = 0; i < NumViews; ++i) {
-		gForegroundMasks[i].release();
-		gForegrounds[i].release();
-	}
-
 	glutTimerFunc(18, update, 0);
 }
 
@@ -320,68 +303,54 @@ static void initialize_glut(int argc, char **argv) {
 
 
 int main(int argc, char** argv) {
-	gFrames = std::vector<cv::Mat>(NumViews);
-	gBackgrounds = std::vector<cv::Mat>(NumViews);
-	gBackgroundsHSV = std::vector<cv::Mat>(NumViews);
-	gForegrounds = std::vector<cv::Mat>(NumViews);
-	gForegroundMasks = std::vector<cv::Mat>(NumViews);
-	gCaptures = std::vector<cv::VideoCapture>(NumViews);
-
-	gCameras = std::vector<std::shared_ptr<Camera>>(NumViews);
-	gHistograms = std::vector<std::shared_ptr<Histogram>>(NumViews);
-
-	// histograms
-	for (int i = 0; i < NumViews; ++i) {
-		gHistograms.push_back(std::make_shared<Histogram>());
+	cv::CommandLineParser parser(argc, argv, Keys);
+	parser.about("Multi-view voxel reconstruction and tracking of two persons");
+	if (parser.has("help")) {
+		parser.printMessage();
+		return 0;
 	}
 
-	// load camera calibration files
-	gCameras.push_back(std::make_shared<Camera>(0, ViewWidth, ViewHeight, "data/camparam_f.ini"));
-	gCameras.push_back(std::make_shared<Camera>(1, ViewWidth, ViewHeight, "data/camparam_l.ini"));
-	gCameras.push_back(std::make_shared<Camera>(2, ViewWidth, ViewHeight, "data/camparam_r.ini"));
-	gCameras.push_back(std::make_shared<Camera>(3, ViewWidth, ViewHeight, "data/camparam_s.ini"));
-
-	// background image
-	gBackgrounds.push_back(cv::imread("data/background_f.bmp", 1));
-	gBackgrounds.push_back(cv::imread("data/background_l.bmp", 1));
-	gBackgrounds.push_back(cv::imread("data/background_r.bmp", 1));
-	gBackgrounds.push_back(cv::imread("data/background_s.bmp", 1));
-
-	// the input videos
-	gCaptures.push_back(cv::VideoCapture("data/video_f.avi"));
-	gCaptures.push_back(cv::VideoCapture("data/video_l.avi"));
-	gCaptures.push_back(cv::VideoCapture("data/video_r.avi"));
-	gCaptures.push_back(cv::VideoCapture("data/video_s.avi"));
-
-	// background in HSV
-	for (int i = 0; i < NumViews; i ++) {
-		gBackgroundsHSV.push_back(cv::Mat(gBackgrounds[i].size(), 8, 3));
-		cv::cvtColor(gBackgrounds[i], gBackgroundsHSV[i], cv::COLOR_BGR2HSV);
+	std::string scenePath = parser.get<std::string>("@scene");
+	std::string debugViews = parser.get<std::string>("debug");
+	double debugRate = parser.get<double>("debug_rate");
+	if (!parser.check()) {
+		parser.printErrors();
+		return 1;
 	}
 
-	gRenderer = std::make_shared<Renderer>(NumViews);
-	
-	// pass init image to tracker
-	gTracker = std::make_shared<Tracker>(cv::imread("data/init-person1.jpg", 1), cv::imread("data/init-person2.jpg", 1), gCameras);
+	// the recorded data set, unless a scene description is given
+	Scene scene;
+	if (!scenePath.empty() && !scene.Load(scenePath)) {
+		return 1;
+	}
 
-	// transfer camera coordinate to 3D scene
-	for (int i = 0; i < NumViews; i ++) {
-		gRenderer->CamCoord(gCameras[i]->Corners);
+	gDebug = std::make_shared<DebugWindows>(debugRate);
+	gDebug->Show(DEBUG_VIDEO, debugViews.find("video") != std::string::npos);
+	gDebug->Show(DEBUG_FOREGROUND, debugViews.find("foreground") != std::string::npos);
+	gDebug->Show(DEBUG_HISTOGRAMS, debugViews.find("histograms") != std::string::npos);
+
+	gPipeline = std::make_shared<Pipeline>(scene);
+	gFramePeriod = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+		std::chrono::duration<double>((scene.Fps > 0.0) ? 1.0 / scene.Fps : 0.0));
+	if (!gPipeline->IsReady()) {
+		return 1;
 	}
 
-	// volumetric reconstruction
-	gVoxelGrid = std::make_shared<VoxelGrid>(ViewWidth, ViewHeight, gCameras);
+	gRenderer = std::make_shared<Renderer>(gPipeline->NumViews);
+
+	// transfer camera coordinate to 3D scene
+	for (int i = 0; i < gPipeline->NumViews; i ++) {
+		gRenderer->CamCoord(gPipeline->Cameras[i]->Corners);
+	}
+	gRenderer->Volume(gPipeline->Grid->volumeCorners);
 
 	initialize_glut(argc, argv);
-	
-	// initialize windows
-	cv::namedWindow("Video Feed", 1);
-	cv::namedWindow("Foreground", 1);
-	cv::namedWindow("Camera Color Histogram", 1);
-	cv::namedWindow("Image Histogram A", 1);
-	cv::namedWindow("Image Histogram B", 1);
-
-	// from now on it's just events
+
+	// start processing and the debug views, from now on it's just events
+	gDebug->Start();
+	gProcessingRunning = true;
+	gProcessing = std::thread(process);
+
 	glutMainLoop();
 
 	return 0;
@@ -1,3 +1,5 @@
+#pragma once
+
 /**
  * 		Original code written by Xinghan Luo. Modifications by Maurits Lam and Marco van Laar.
  * 
@@ -8,6 +10,9 @@
  * 		Additional keyboard controls:
  * 			L		show/hide tracking lines in the scene
  * 			B		show/hide tracking boxes in the scene
+ * 			I		show/hide the video feed of the current view
+ * 			F		show/hide the foreground of the current view
+ * 			H		show/hide the histograms of the current view
  *
  * 		Mouse controls:
  * 			LMB		hold and drag to rotate around origin (when not in topview)
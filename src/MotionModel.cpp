@@ -0,0 +1,64 @@
+#include "MotionModel.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+#include <opencv2/opencv.hpp>
+
+// acceleration noise in millimeters per frame squared, and the noise of a measured position in millimeters
+static const float AccelerationNoise = 15.f;
+static const float MeasurementNoise = 120.f;
+
+// velocity uncertainty of a new track (about 2.5 m/s at 25 frames per second)
+static const float InitialVelocityNoise = 100.f;
+
+MotionModel::MotionModel() : filter(4, 2, 0, CV_32F), initialized(false) {
+	filter.transitionMatrix = (cv::Mat_<float>(4, 4) <<
+		1, 0, 1, 0,
+		0, 1, 0, 1,
+		0, 0, 1, 0,
+		0, 0, 0, 1);
+
+	cv::setIdentity(filter.measurementMatrix);
+
+	// piecewise constant acceleration between frames
+	float q = AccelerationNoise * AccelerationNoise;
+	filter.processNoiseCov = (cv::Mat_<float>(4, 4) <<
+		q / 4, 0,     q / 2, 0,
+		0,     q / 4, 0,     q / 2,
+		q / 2, 0,     q,     0,
+		0,     q / 2, 0,     q);
+
+	cv::setIdentity(filter.measurementNoiseCov, cv::Scalar::all(MeasurementNoise * MeasurementNoise));
+}
+
+bool MotionModel::IsInitialized() const {
+	return initialized;
+}
+
+cv::Point2f MotionModel::Predict() {
+	cv::Mat state = filter.predict();
+	return cv::Point2f(state.at<float>(0), state.at<float>(1));
+}
+
+cv::Point2f MotionModel::Correct(cv::Point2f measurement) {
+	if (!initialized) {
+		filter.statePost = (cv::Mat_<float>(4, 1) << measurement.x, measurement.y, 0.f, 0.f);
+		filter.errorCovPost = cv::Mat::diag((cv::Mat_<float>(4, 1) <<
+			MeasurementNoise * MeasurementNoise,
+			MeasurementNoise * MeasurementNoise,
+			InitialVelocityNoise * InitialVelocityNoise,
+			InitialVelocityNoise * InitialVelocityNoise));
+		initialized = true;
+		return measurement;
+	}
+
+	cv::Mat state = filter.correct((cv::Mat_<float>(2, 1) << measurement.x, measurement.y));
+	return cv::Point2f(state.at<float>(0), state.at<float>(1));
+}
+
+float MotionModel::Uncertainty() const {
+	float varX = filter.errorCovPre.at<float>(0, 0);
+	float varY = filter.errorCovPre.at<float>(1, 1);
+	return std::sqrt(std::max(varX, varY));
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+// Constant-velocity Kalman filter of a target on the ground plane (state x, y, vx, vy in millimeters per frame).
+class MotionModel {
+public:
+	MotionModel();
+
+public:
+	bool IsInitialized() const;
+
+	cv::Point2f Predict();							// predicted position in the current frame
+	cv::Point2f Correct(cv::Point2f measurement);	// filtered position, starts the track on the first measurement
+	float Uncertainty() const;						// standard deviation of the predicted position
+
+private:
+	cv::KalmanFilter filter;
+	bool initialized;
+};
@@ -0,0 +1,382 @@
+#include "OccupancyStream.hpp"
+
+#include <bit>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+
+#include "BinaryIO.hpp"
+
+static const uint32_t OccupancyMagic = 0x434f424f; // "OBOC"
+static const uint32_t OccupancyVersion = 2;
+static const uint32_t IndexMagic = 0x584f424f; // "OBOX"
+static const uint32_t EndOfRecords = 0xffffffff;
+
+// header: magic, version and seven grid values
+static const uint64_t HeaderSize = 2 * sizeof(uint32_t) + 7 * sizeof(int32_t);
+// index footer: number of keyframes, offset of the index and magic
+static const uint64_t FooterSize = sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint32_t);
+
+// records are written once this many bytes are buffered
+static const size_t FlushSize = 1 << 20;
+
+using namespace BinaryIO;
+
+static size_t numWords(int numVoxels) {
+	return (static_cast<size_t>(numVoxels) + 63) / 64;
+}
+
+OccupancyWriter::OccupancyWriter() : KeyframeInterval(100), fileOffset(0), framesSinceKeyframe(0) {
+	buffer.reserve(2 * FlushSize);
+}
+
+OccupancyWriter::~OccupancyWriter() {
+	Close();
+}
+
+bool OccupancyWriter::Open(std::string const& path, OccupancyHeader const& header) {
+	file.open(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		std::cerr << "Unable to write occupancy stream " << path << std::endl;
+		return false;
+	}
+
+	Header = header;
+	fileOffset = 0;
+	framesSinceKeyframe = 0;
+	keyframes.clear();
+	current.assign(numWords(Header.NumVoxels()), 0);
+	previous.clear();
+
+	buffer.clear();
+	put(buffer, OccupancyMagic);
+	put(buffer, OccupancyVersion);
+	put(buffer, static_cast<int32_t>(Header.NumX));
+	put(buffer, static_cast<int32_t>(Header.NumY));
+	put(buffer, static_cast<int32_t>(Header.NumZ));
+	put(buffer, static_cast<int32_t>(Header.Origin.x));
+	put(buffer, static_cast<int32_t>(Header.Origin.y));
+	put(buffer, static_cast<int32_t>(Header.Origin.z));
+	put(buffer, static_cast<int32_t>(Header.VoxelSize));
+	return true;
+}
+
+bool OccupancyWriter::Write(OccupancyFrame const& frame) {
+	if (!file.is_open()) {
+		return false;
+	}
+
+	int numVoxels = Header.NumVoxels();
+	sorted.assign(frame.Voxels.begin(), frame.Voxels.end());
+	std::sort(sorted.begin(), sorted.end());
+	sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+	std::fill(current.begin(), current.end(), 0);
+	for (int v : sorted) {
+		current[v >> 6] |= uint64_t(1) << (v & 63);
+	}
+
+	// keyframe: differences between sorted indices, unless the bitset is smaller
+	keyPayload.clear();
+	int last = 0;
+	for (int v : sorted) {
+		putVarint(keyPayload, static_cast<uint32_t>(v - last));
+		last = v;
+	}
+
+	uint8_t encoding = OCCUPANCY_DELTAS;
+	size_t bitsetSize = (static_cast<size_t>(numVoxels) + 7) / 8;
+	if (keyPayload.size() > bitsetSize) {
+		encoding = OCCUPANCY_BITSET;
+		keyPayload.resize(bitsetSize);
+		std::memcpy(keyPayload.data(), current.data(), bitsetSize);
+	}
+
+	// other frames: run lengths between the voxels that changed since the previous frame
+	std::vector<uint8_t> const* payload = &keyPayload;
+	if (!previous.empty() && framesSinceKeyframe + 1 < KeyframeInterval) {
+		xorPayload.clear();
+		uint32_t position = 0;
+		for (size_t w = 0; w < current.size(); ++w) {
+			uint64_t changed = current[w] ^ previous[w];
+			while (changed) {
+				uint32_t v = static_cast<uint32_t>(w * 64 + std::countr_zero(changed));
+				putVarint(xorPayload, v - position);
+				position = v;
+				changed &= changed - 1;
+			}
+		}
+
+		if (xorPayload.size() < keyPayload.size()) {
+			encoding = OCCUPANCY_XOR;
+			payload = &xorPayload;
+		}
+	}
+
+	if (encoding == OCCUPANCY_XOR) {
+		framesSinceKeyframe++;
+	}
+	else {
+		framesSinceKeyframe = 0;
+		keyframes.push_back({ frame.FrameIndex, fileOffset + buffer.size() });
+	}
+	std::swap(current, previous);
+	if (current.empty()) {
+		current.assign(previous.size(), 0);
+	}
+
+	uint8_t numTargets = static_cast<uint8_t>(std::min<size_t>(frame.Targets.size(), 255));
+	uint32_t size = static_cast<uint32_t>(
+		sizeof(int32_t) + sizeof(double) + 4 +
+		numTargets * 3 * sizeof(float) +
+		sizeof(uint32_t) + payload->size());
+
+	put(buffer, size);
+	put(buffer, static_cast<int32_t>(frame.FrameIndex));
+	put(buffer, frame.Timestamp);
+	put(buffer, encoding);
+	put(buffer, numTargets);
+	put(buffer, static_cast<uint16_t>(0));
+	for (int t = 0; t < numTargets; ++t) {
+		put(buffer, frame.Targets[t].x);
+		put(buffer, frame.Targets[t].y);
+		put(buffer, frame.Targets[t].z);
+	}
+	put(buffer, static_cast<uint32_t>(sorted.size()));
+	buffer.insert(buffer.end(), payload->begin(), payload->end());
+
+	if (buffer.size() >= FlushSize) {
+		return flush();
+	}
+	return true;
+}
+
+bool OccupancyWriter::flush() {
+	file.write(reinterpret_cast<char const*>(buffer.data()), buffer.size());
+	fileOffset += buffer.size();
+	buffer.clear();
+	return static_cast<bool>(file);
+}
+
+bool OccupancyWriter::Close() {
+	if (!file.is_open()) {
+		return true;
+	}
+
+	// keyframe index, so readers can seek without scanning the records
+	put(buffer, EndOfRecords);
+	uint64_t indexOffset = fileOffset + buffer.size();
+	for (OccupancyKeyframe const& keyframe : keyframes) {
+		put(buffer, static_cast<int32_t>(keyframe.FrameIndex));
+		put(buffer, keyframe.Offset);
+	}
+	put(buffer, static_cast<uint32_t>(keyframes.size()));
+	put(buffer, indexOffset);
+	put(buffer, IndexMagic);
+
+	bool ok = flush();
+	file.close();
+	return ok;
+}
+
+bool OccupancyReader::Open(std::string const& path) {
+	file.open(path, std::ios::binary);
+	if (!file.is_open()) {
+		std::cerr << "Unable to open occupancy stream " << path << std::endl;
+		return false;
+	}
+
+	uint32_t magic = 0;
+	int32_t values[7];
+	read(file, magic);
+	read(file, version);
+	file.read(reinterpret_cast<char*>(values), sizeof(values));
+	if (!file || magic != OccupancyMagic || version < 1 || version > OccupancyVersion) {
+		std::cerr << path << " is not an occupancy stream" << std::endl;
+		return false;
+	}
+
+	Header.NumX = values[0];
+	Header.NumY = values[1];
+	Header.NumZ = values[2];
+	Header.Origin = cv::Point3i(values[3], values[4], values[5]);
+	Header.VoxelSize = values[6];
+
+	firstRecord = HeaderSize;
+	occupancy.assign(numWords(Header.NumVoxels()), 0);
+
+	// streams that were not closed have no index
+	if (!readIndex()) {
+		scanKeyframes();
+	}
+
+	file.clear();
+	file.seekg(firstRecord);
+	return true;
+}
+
+bool OccupancyReader::readIndex() {
+	if (version < 2 || !file.seekg(0, std::ios::end)) {
+		return false;
+	}
+
+	uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+	if (fileSize < HeaderSize + FooterSize) {
+		return false;
+	}
+
+	uint32_t count = 0;
+	uint64_t indexOffset = 0;
+	uint32_t magic = 0;
+	file.seekg(fileSize - FooterSize);
+	if (!read(file, count) || !read(file, indexOffset) || !read(file, magic) || magic != IndexMagic ||
+		indexOffset + count * (sizeof(int32_t) + sizeof(uint64_t)) + FooterSize != fileSize) {
+		return false;
+	}
+
+	file.seekg(indexOffset);
+	Keyframes.resize(count);
+	for (OccupancyKeyframe& keyframe : Keyframes) {
+		int32_t frameIndex = 0;
+		read(file, frameIndex);
+		read(file, keyframe.Offset);
+		keyframe.FrameIndex = frameIndex;
+	}
+	return static_cast<bool>(file);
+}
+
+// Builds the keyframe index by skipping from record to record.
+void OccupancyReader::scanKeyframes() {
+	Keyframes.clear();
+	file.clear();
+	file.seekg(firstRecord);
+
+	while (true) {
+		uint64_t offset = static_cast<uint64_t>(file.tellg());
+		uint32_t size = 0;
+		int32_t frameIndex = 0;
+		double timestamp = 0.0;
+		uint8_t encoding = 0;
+		if (!read(file, size) || size == EndOfRecords || size < sizeof(frameIndex) + sizeof(timestamp) + 1) {
+			break;
+		}
+		if (!read(file, frameIndex) || !read(file, timestamp) || !read(file, encoding)) {
+			break;
+		}
+		if (encoding != OCCUPANCY_XOR) {
+			Keyframes.push_back({ frameIndex, offset });
+		}
+		file.seekg(offset + sizeof(size) + size);
+	}
+}
+
+bool OccupancyReader::peekFrameIndex(int& frameIndex) {
+	std::streampos position = file.tellg();
+	uint32_t size = 0;
+	int32_t index = 0;
+	bool ok = read(file, size) && size != EndOfRecords && read(file, index);
+	file.clear();
+	file.seekg(position);
+	frameIndex = index;
+	return ok;
+}
+
+bool OccupancyReader::Seek(int frameIndex) {
+	// last keyframe at or before the frame
+	auto keyframe = std::upper_bound(Keyframes.begin(), Keyframes.end(), frameIndex,
+		[](int index, OccupancyKeyframe const& k) { return index < k.FrameIndex; });
+	if (keyframe == Keyframes.begin()) {
+		file.clear();
+		file.seekg(firstRecord);
+		return !Keyframes.empty();
+	}
+	--keyframe;
+
+	file.clear();
+	file.seekg(keyframe->Offset);
+
+	// decode up to the frame, so the frames in between are applied to the occupancy
+	OccupancyFrame skipped;
+	int next = 0;
+	while (peekFrameIndex(next) && next < frameIndex) {
+		if (!Read(skipped)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool OccupancyReader::Read(OccupancyFrame& frame) {
+	uint32_t size = 0;
+	if (!read(file, size) || size == EndOfRecords) {
+		return false;
+	}
+
+	record.resize(size);
+	file.read(reinterpret_cast<char*>(record.data()), size);
+	if (!file) {
+		std::cerr << "Truncated occupancy record" << std::endl;
+		return false;
+	}
+
+	size_t offset = 0;
+	int32_t frameIndex = 0;
+	uint8_t encoding = 0;
+	uint8_t numTargets = 0;
+	uint16_t reserved = 0;
+	get(record, offset, frameIndex);
+	get(record, offset, frame.Timestamp);
+	get(record, offset, encoding);
+	get(record, offset, numTargets);
+	get(record, offset, reserved);
+	frame.FrameIndex = frameIndex;
+
+	frame.Targets.resize(numTargets);
+	for (cv::Point3f& target : frame.Targets) {
+		get(record, offset, target.x);
+		get(record, offset, target.y);
+		get(record, offset, target.z);
+	}
+
+	uint32_t count = 0;
+	if (!get(record, offset, count)) {
+		std::cerr << "Corrupt occupancy record" << std::endl;
+		return false;
+	}
+
+	int numVoxels = Header.NumVoxels();
+	if (encoding == OCCUPANCY_BITSET) {
+		size_t bytes = std::min((static_cast<size_t>(numVoxels) + 7) / 8, record.size() - offset);
+		std::fill(occupancy.begin(), occupancy.end(), 0);
+		std::memcpy(occupancy.data(), record.data() + offset, bytes);
+	}
+	else {
+		// absolute indices for keyframes, changed voxels otherwise
+		if (encoding == OCCUPANCY_DELTAS) {
+			std::fill(occupancy.begin(), occupancy.end(), 0);
+		}
+
+		uint32_t index = 0;
+		while (offset < record.size()) {
+			uint32_t delta = 0;
+			if (!getVarint(record, offset, delta) || index + delta >= static_cast<uint32_t>(numVoxels)) {
+				std::cerr << "Corrupt occupancy record" << std::endl;
+				return false;
+			}
+			index += delta;
+			occupancy[index >> 6] ^= uint64_t(1) << (index & 63);
+		}
+	}
+
+	frame.Voxels.clear();
+	frame.Voxels.reserve(count);
+	for (size_t w = 0; w < occupancy.size(); ++w) {
+		uint64_t bits = occupancy[w];
+		while (bits) {
+			frame.Voxels.push_back(static_cast<int>(w * 64 + std::countr_zero(bits)));
+			bits &= bits - 1;
+		}
+	}
+
+	return frame.Voxels.size() == count;
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+
+#include <opencv2/opencv.hpp>
+
+/**
+ * 		Binary stream of the per-frame results: the occupied voxels and the target positions.
+ *
+ * 		All values are little-endian. The file starts with a header describing the voxel grid,
+ * 		followed by one record per frame and an index of the keyframes:
+ *
+ * 			header		"OBOC", version, voxels along x/y/z, grid origin (mm), voxel size (mm)	(36 bytes)
+ * 			record		size of the rest of the record							uint32
+ * 						frame index												int32
+ * 						timestamp in milliseconds								float64
+ * 						voxel encoding, number of targets, reserved				uint8, uint8, uint16
+ * 						target positions (x, y, z in mm)						float32 * 3 * targets
+ * 						number of occupied voxels								uint32
+ * 						occupied voxels
+ * 			index		0xffffffff (end of the records)							uint32
+ * 						frame index and file offset of every keyframe			(int32, uint64) * keyframes
+ * 						number of keyframes, offset of the index, "OBOX"		uint32, uint64, uint32
+ *
+ * 		Voxel indices follow the order of the grid (x, then y, then z changing fastest). A keyframe
+ * 		stores them either as a bitset over all voxels, or as the varint-encoded differences between
+ * 		the sorted indices. Other frames store the voxels that changed since the previous frame (the
+ * 		set bits of the XOR of both occupancy bitsets) as varint-encoded run lengths. Every frame uses
+ * 		the smallest of these, and a keyframe is forced at a fixed interval so readers can seek.
+ */
+
+// Voxel grid the indices of a stream refer to.
+struct OccupancyHeader {
+	int NumX = 0;
+	int NumY = 0;
+	int NumZ = 0;
+	cv::Point3i Origin;		// lower corner of the grid
+	int VoxelSize = 0;
+
+	int NumVoxels() const { return NumX * NumY * NumZ; }
+};
+
+// Results of a single frame.
+struct OccupancyFrame {
+	int FrameIndex = 0;
+	double Timestamp = 0.0;
+	std::vector<cv::Point3f> Targets;
+	std::vector<int> Voxels;	// indices of the occupied voxels (sorted when read)
+};
+
+enum OccupancyEncoding {
+	OCCUPANCY_DELTAS = 0,		// keyframe, differences between the sorted indices
+	OCCUPANCY_BITSET = 1,		// keyframe, bitset over all voxels
+	OCCUPANCY_XOR = 2			// changes since the previous frame
+};
+
+// Frame index and file offset of a keyframe.
+struct OccupancyKeyframe {
+	int FrameIndex;
+	uint64_t Offset;
+};
+
+class OccupancyWriter {
+public:
+	OccupancyWriter();
+	~OccupancyWriter();
+
+public:
+	bool Open(std::string const& path, OccupancyHeader const&);
+	bool Write(OccupancyFrame const&);	// voxel indices may be in any order
+	bool Close();
+
+public:
+	OccupancyHeader Header;
+	int KeyframeInterval;				// maximum number of frames between keyframes
+
+private:
+	bool flush();
+
+private:
+	std::ofstream file;
+	uint64_t fileOffset;				// bytes written to the file so far
+
+	std::vector<uint8_t> buffer;		// records are collected and written in large blocks
+	std::vector<int> sorted;
+	std::vector<uint8_t> keyPayload;
+	std::vector<uint8_t> xorPayload;
+
+	// occupancy bitsets of the current and previous frame
+	std::vector<uint64_t> current;
+	std::vector<uint64_t> previous;
+	int framesSinceKeyframe;
+
+	std::vector<OccupancyKeyframe> keyframes;
+};
+
+class OccupancyReader {
+public:
+	bool Open(std::string const& path);
+	bool Read(OccupancyFrame&);			// returns false at the end of the stream
+	bool Seek(int frameIndex);			// the next read returns the first frame at or after the given index
+
+public:
+	OccupancyHeader Header;
+	std::vector<OccupancyKeyframe> Keyframes;
+
+private:
+	bool readIndex();
+	void scanKeyframes();
+	bool peekFrameIndex(int& frameIndex);
+
+private:
+	std::ifstream file;
+	uint32_t version;
+	uint64_t firstRecord;
+
+	std::vector<uint8_t> record;
+	std::vector<uint64_t> occupancy;	// bitset of the last frame that was read
+};
@@ -0,0 +1,354 @@
+#include "Pipeline.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+
+#include <opencv2/opencv.hpp>
+
+#include "Main.hpp"
+#include "Camera.hpp"
+#include "Tracker.hpp"
+#include "Histogram.hpp"
+#include "VoxelGrid.hpp"
+#include "GroundPlane.hpp"
+#include "VoxelKMeans.hpp"
+#include "VoxelClusters.hpp"
+
+namespace {
+	// Measures the time between consecutive laps in milliseconds.
+	class Stopwatch {
+	public:
+		Stopwatch() : last(std::chrono::steady_clock::now()) {}
+
+		double Lap() {
+			auto now = std::chrono::steady_clock::now();
+			double ms = std::chrono::duration<double, std::milli>(now - last).count();
+			last = now;
+			return ms;
+		}
+
+	private:
+		std::chrono::steady_clock::time_point last;
+	};
+}
+
+Pipeline::Pipeline(Scene const& scene, PipelineOptions const& options) :
+NumViews(casti(scene.Views.size())), ViewWidth(scene.Width), ViewHeight(scene.Height), FrameIndex(-1), Timestamp(0.0), Options(options), ready(true) {
+	Frames = std::vector<cv::Mat>(NumViews);
+	Foregrounds = std::vector<cv::Mat>(NumViews);
+	ForegroundMasks = std::vector<cv::Mat>(NumViews);
+
+	// a recording replaces the backgrounds and videos
+	if (!Options.ReplayFile.empty()) {
+		replaying = std::make_shared<RecordingReader>();
+		if (!replaying->Open(Options.ReplayFile)) {
+			ready = false;
+		}
+		else if (replaying->NumViews != NumViews || replaying->ViewWidth != ViewWidth || replaying->ViewHeight != ViewHeight) {
+			std::cerr << "Recording " << Options.ReplayFile << " does not match the scene" << std::endl;
+			ready = false;
+		}
+	}
+
+	// decoded frames replace the videos
+	else if (!Options.RawFramesFile.empty()) {
+		rawFrames = std::make_shared<RawFrameReader>();
+		if (!rawFrames->Open(Options.RawFramesFile)) {
+			ready = false;
+		}
+		else if (rawFrames->NumViews != NumViews || rawFrames->ViewWidth != ViewWidth || rawFrames->ViewHeight != ViewHeight) {
+			std::cerr << "Frames " << Options.RawFramesFile << " do not match the scene" << std::endl;
+			ready = false;
+		}
+	}
+
+	// the views are read in frame sets by capture time
+	if (!replaying) {
+		Sync = std::make_shared<FrameSync>((rawFrames && rawFrames->Fps > 0.0) ? rawFrames->Fps : scene.Fps);
+		Sync->Tolerance = Options.SyncTolerance;
+		Sync->HoldFrames = Options.HoldFrames;
+	}
+	blankFrame = cv::Mat::zeros(ViewHeight, ViewWidth, CV_8UC3);
+	blankMask = cv::Mat::zeros(ViewHeight, ViewWidth, CV_8U);
+	fullMask = cv::Mat(ViewHeight, ViewWidth, CV_8U, cv::Scalar(255));
+
+	for (int i = 0; i < NumViews; ++i) {
+		ViewSource const& view = scene.Views[i];
+
+		// camera calibration and undistortion tables
+		Cameras.push_back(std::make_shared<Camera>(i, ViewWidth, ViewHeight, view.calibration));
+		Cameras[i]->InitUndistortion(Options.CacheUndistortion ? view.calibration + ".undistort" : "", Options.UndistortMasks);
+		Cameras[i]->UndistortForeground = Options.UndistortMasks;
+
+		// histograms
+		Histograms.push_back(std::make_shared<Histogram>());
+
+		if (replaying) {
+			continue;
+		}
+
+		// background model, starting from the captured background
+		cv::Mat background = cv::imread(view.background, cv::IMREAD_COLOR);
+		if (background.empty()) {
+			std::cerr << "Unable to read background " << view.background << std::endl;
+			ready = false;
+			background = cv::Mat::zeros(ViewHeight, ViewWidth, CV_8UC3);
+		}
+		backgrounds.push_back(BackgroundModel());
+		backgrounds[i].LearningShift = Options.BackgroundLearningShift;
+		backgrounds[i].Init(background);
+
+		// the input video
+		if (rawFrames) {
+			Sync->AddRawView(rawFrames, i);
+		}
+		else if (!Sync->AddVideo(view.video)) {
+			std::cerr << "Unable to open video " << view.video << std::endl;
+			ready = false;
+		}
+	}
+
+	// pass init images to tracker
+	PersonTracker = std::make_shared<Tracker>(
+		cv::imread(scene.Persons[0], cv::IMREAD_COLOR),
+		cv::imread(scene.Persons[1], cv::IMREAD_COLOR),
+		Cameras);
+	PersonTracker->IgnoredView = scene.IgnoredView;
+	PersonTracker->UseSearchRegions = Options.SearchRegions;
+
+	// volumetric reconstruction
+	Grid = std::make_shared<VoxelGrid>(ViewWidth, ViewHeight, Cameras, Options.Occlusion);
+
+	// only the part of each view that can see the volume is processed
+	regions.assign(NumViews, cv::Rect(0, 0, ViewWidth, ViewHeight));
+	for (int i = 0; i < NumViews && Options.VolumeRegion; ++i) {
+		Cameras[i]->InitVolumeRegion(Grid->volumeCorners);
+		if (!Cameras[i]->VolumeBounds.empty()) {
+			regions[i] = Cameras[i]->VolumeBounds;
+		}
+		if (i < casti(backgrounds.size())) {
+			backgrounds[i].SetRegion(Cameras[i]->VolumeSpans, Cameras[i]->VolumeBounds);
+		}
+	}
+	Clustering = std::make_shared<VoxelClusters>();
+	Ground = std::make_shared<GroundPlane>();
+	Assignment = std::make_shared<VoxelKMeans>();
+
+	if (replaying && replaying->NumVoxels != Grid->numVoxels) {
+		std::cerr << "Recording " << Options.ReplayFile << " was made with another voxel grid" << std::endl;
+		ready = false;
+	}
+
+	if (!Options.RecordFile.empty()) {
+		recording = std::make_shared<RecordingWriter>();
+		if (!recording->Open(Options.RecordFile, NumViews, ViewWidth, ViewHeight, Grid->numVoxels)) {
+			ready = false;
+		}
+	}
+}
+
+bool Pipeline::IsReady() const {
+	return ready;
+}
+
+bool Pipeline::Update() {
+	Times = StageTimes();
+
+	// foregrounds and carved voxels, from the videos or from a recording
+	if (!(replaying ? replay() : capture())) {
+		return false;
+	}
+
+	Stopwatch stopwatch;
+
+	// appearance of the carved voxels
+	if (Options.Occlusion) {
+		Grid->FindSurfaces(Cameras, PersonTracker->MissingViews);
+	}
+	Grid->SampleColors(Frames, PersonTracker->MissingViews);
+	Times.Coloring = stopwatch.Lap();
+
+	// group the carved voxels into objects, in 3D and on the ground plane
+	Clustering->Update(*Grid);
+	Ground->Detect(*Grid);
+	Times.Clustering = stopwatch.Lap();
+
+	// find the persons in the 3D grid
+	PersonTracker->TrackPersons(Foregrounds, NumViews);
+	Ground->Associate({
+		cv::Point2f(PersonTracker->PersonPosA.x, PersonTracker->PersonPosA.y),
+		cv::Point2f(PersonTracker->PersonPosB.x, PersonTracker->PersonPosB.y) });
+	Times.Tracking = stopwatch.Lap();
+
+	// label persons, by clustering the voxels around the tracked positions or by boxes around them
+	if (Options.ClusterLabels) {
+		Assignment->Update(*Grid, {
+			cv::Point2f(PersonTracker->PersonPosA.x, PersonTracker->PersonPosA.y),
+			cv::Point2f(PersonTracker->PersonPosB.x, PersonTracker->PersonPosB.y) });
+		Assignment->Label(*Grid, { CV_RGB(0, 200, 0), CV_RGB(0, 0, 200) });
+	}
+	else {
+		PersonTracker->LabelVoxels(Grid, PersonTracker->PersonPosA, 350.f, 750.f, CV_RGB(0, 200, 0));
+		PersonTracker->LabelVoxels(Grid, PersonTracker->PersonPosB, 350.f, 750.f, CV_RGB(0, 0, 200));
+	}
+	Times.Labeling = stopwatch.Lap();
+
+	FrameIndex = replaying ? recorded.FrameIndex : FrameIndex + 1;
+
+	if (recording && !recording->Write(FrameIndex, Timestamp, ForegroundMasks, Frames, Grid->visibleIndices, Sync ? Sync->Status : recorded.Status)) {
+		std::cerr << "Unable to write recording " << Options.RecordFile << std::endl;
+		recording.reset();
+	}
+
+	return true;
+}
+
+bool Pipeline::capture() {
+	Stopwatch stopwatch;
+
+	// get the next frame set from the videos (or the raw frame file), it ends when all views have ended
+	if (!Sync->Read(Frames, Timestamp)) {
+		return false;
+	}
+	Times.Capture = stopwatch.Lap();
+
+	for (int i = 0; i < NumViews; ++i) {
+		// a missing view does not constrain the carving and is left out of the tracking
+		bool missing = Sync->Status[i] == FRAME_MISSING;
+		PersonTracker->MissingViews[i] = missing;
+		if (missing) {
+			Frames[i] = blankFrame;
+			ForegroundMasks[i] = blankMask;
+			Foregrounds[i] = blankFrame;
+			Cameras[i]->Foreground = fullMask.clone();	// the camera may undistort into its mask later
+			continue;
+		}
+
+		ForegroundMasks[i] = backgrounds[i].Apply(Frames[i]);
+		Foregrounds[i] = PersonTracker->ExtractForeground(Frames[i], ForegroundMasks[i]);
+
+		// carving uses the undistorted mask, tracking back-projects through the ray table
+		if (Options.UndistortMasks) {
+			Cameras[i]->UndistortMask(ForegroundMasks[i], Cameras[i]->Foreground);
+		}
+		else {
+			Cameras[i]->Foreground = ForegroundMasks[i];
+		}
+	}
+	Times.Foreground = stopwatch.Lap();
+
+	for (int i = 0; i < NumViews; ++i) {
+		Histograms[i]->CreateColorHistogram(Frames[i](regions[i]), ForegroundMasks[i](regions[i]));
+	}
+	Times.Histograms = stopwatch.Lap();
+
+	Grid->UpdateVoxels(Cameras);
+	Times.Voxels = stopwatch.Lap();
+
+	return true;
+}
+
+// Restores the masks, foreground colors and carved voxels of a recorded frame.
+// The frames themselves are not recorded, they are replaced by the foregrounds.
+bool Pipeline::replay() {
+	Stopwatch stopwatch;
+
+	if (!replaying->Read(recorded)) {
+		return false;
+	}
+	Timestamp = recorded.Timestamp;
+	Times.Capture = stopwatch.Lap();
+
+	for (int i = 0; i < NumViews; ++i) {
+		bool missing = recorded.Status[i] == FRAME_MISSING;
+		PersonTracker->MissingViews[i] = missing;
+		ForegroundMasks[i] = recorded.Masks[i];
+		Foregrounds[i] = recorded.Foregrounds[i];
+		Frames[i] = recorded.Foregrounds[i];
+
+		// the camera masks match capture(), the recorded masks are distorted like the frames
+		if (missing) {
+			Cameras[i]->Foreground = fullMask.clone();
+		}
+		else if (Options.UndistortMasks) {
+			Cameras[i]->UndistortMask(ForegroundMasks[i], Cameras[i]->Foreground);
+		}
+		else {
+			Cameras[i]->Foreground = ForegroundMasks[i];
+		}
+	}
+	Times.Foreground = stopwatch.Lap();
+
+	for (int i = 0; i < NumViews; ++i) {
+		Histograms[i]->CreateColorHistogram(Frames[i](regions[i]), ForegroundMasks[i](regions[i]));
+	}
+	Times.Histograms = stopwatch.Lap();
+
+	Grid->SetVisibleVoxels(recorded.Voxels);
+	Times.Voxels = stopwatch.Lap();
+
+	return true;
+}
+
+void Pipeline::Snapshot(FrameSnapshot& snapshot, int view, bool frame, bool foreground, bool histograms) const {
+	snapshot.FrameIndex = FrameIndex;
+
+	// the buffers of the snapshot are reused, so this does not allocate once they are large enough
+	std::vector<Voxel> const& visible = Grid->visibleVoxels;
+	bool sampled = Options.VoxelColors && Grid->visibleColors.size() == visible.size();
+	snapshot.Voxels.resize(visible.size());
+	for (size_t v = 0; v < visible.size(); ++v) {
+		Voxel const& voxel = visible[v];
+		if (sampled) {
+			cv::Vec3b const& color = Grid->visibleColors[v];
+			snapshot.Voxels[v] = { castf(voxel.x), castf(voxel.y), castf(voxel.z), color[2], color[1], color[0], 255 };
+			continue;
+		}
+
+		snapshot.Voxels[v] = {
+			castf(voxel.x),
+			castf(voxel.y),
+			castf(voxel.z),
+			cv::saturate_cast<uint8_t>(voxel.r),
+			cv::saturate_cast<uint8_t>(voxel.g),
+			cv::saturate_cast<uint8_t>(voxel.b),
+			255
+		};
+	}
+
+	snapshot.PersonPosA = PersonTracker->PersonPosA;
+	snapshot.PersonPosB = PersonTracker->PersonPosB;
+	snapshot.LinePosWorldA = PersonTracker->GetLinePosWorldA();
+	snapshot.LinePosWorldB = PersonTracker->GetLinePosWorldB();
+
+	// no debug images for a negative view
+	snapshot.HasHistograms = false;
+	if (view < 0) {
+		return;
+	}
+
+	// only the images of the open windows are copied, the others are left empty
+	snapshot.View = std::min(view, NumViews - 1);
+	if (frame) {
+		Frames[snapshot.View].copyTo(snapshot.Frame);
+	}
+	else {
+		snapshot.Frame.release();
+	}
+	if (foreground) {
+		Foregrounds[snapshot.View].copyTo(snapshot.Foreground);
+	}
+	else {
+		snapshot.Foreground.release();
+	}
+
+	// the histograms are only rendered when they change and someone looks at them
+	if (!histograms) {
+		return;
+	}
+	snapshot.HasHistograms = true;
+	Histograms[snapshot.View]->GetRenderedImage().copyTo(snapshot.ColorHistogram);
+	PersonTracker->GetImageHistogramA(snapshot.View).GetRenderedImage().copyTo(snapshot.ImageHistogramA);
+	PersonTracker->GetImageHistogramB(snapshot.View).GetRenderedImage().copyTo(snapshot.ImageHistogramB);
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "Scene.hpp"
+#include "Recording.hpp"
+#include "RawFrames.hpp"
+#include "FrameSync.hpp"
+#include "BackgroundModel.hpp"
+#include "FrameSnapshot.hpp"
+
+class Camera;
+class Tracker;
+class Histogram;
+class VoxelGrid;
+class VoxelClusters;
+class GroundPlane;
+class VoxelKMeans;
+
+// Time spent in each stage of the last processed frame, in milliseconds.
+struct StageTimes {
+	double Capture = 0.0;
+	double Foreground = 0.0;
+	double Histograms = 0.0;
+	double Voxels = 0.0;
+	double Coloring = 0.0;
+	double Clustering = 0.0;
+	double Tracking = 0.0;
+	double Labeling = 0.0;
+
+	double Total() const {
+		return Capture + Foreground + Histograms + Voxels + Coloring + Clustering + Tracking + Labeling;
+	}
+};
+
+// Processing options of the pipeline.
+struct PipelineOptions {
+	bool UndistortMasks = false;		// carve with undistorted foreground masks
+	bool CacheUndistortion = false;		// store the undistortion tables next to the calibration files
+	int BackgroundLearningShift = 8;	// backgrounds adapt 1 / 2^n towards each frame (0 for fixed backgrounds)
+	bool VolumeRegion = true;			// skip the pixels outside the projection of the acquisition volume
+	bool SearchRegions = true;			// track in the regions around the predicted positions only
+	bool ClusterLabels = true;			// label the voxels by k-means clustering instead of fixed boxes
+	bool VoxelColors = false;			// snapshots show the sampled voxel colors instead of the person labels
+	bool Occlusion = false;				// sample the voxel colors from views in which the voxels are not occluded
+
+	std::string RecordFile;				// record the tracker inputs of every frame to this file
+	std::string ReplayFile;				// replay a recording instead of processing the videos
+	std::string RawFramesFile;			// read the frames from a raw frame file instead of decoding the videos
+
+	double SyncTolerance = 0.5;			// frames within this many frame periods of each other form a frame set
+	int HoldFrames = 5;					// frame periods a view without new frames keeps its last frame
+};
+
+// Per-frame processing without any windows: capture, background subtraction, voxel carving and tracking.
+class Pipeline {
+public:
+	Pipeline(Scene const&, PipelineOptions const& = PipelineOptions());
+
+public:
+	bool IsReady() const;	// all inputs could be opened
+	bool Update();			// process the next frame set, returns false at the end of the input
+
+	// copies the results of the last frame, with the debug images of the given view that are asked
+	// for (none for -1)
+	void Snapshot(FrameSnapshot&, int view, bool frame = true, bool foreground = true, bool histograms = true) const;
+
+public:
+	int NumViews;
+	int ViewWidth;
+	int ViewHeight;
+	int FrameIndex;			// index of the last processed frame (-1 before the first)
+	double Timestamp;		// capture time of the last processed frame in milliseconds
+
+	PipelineOptions Options;
+	StageTimes Times;
+
+	std::vector<cv::Mat> Frames;
+	std::vector<cv::Mat> Foregrounds;
+	std::vector<cv::Mat> ForegroundMasks;
+
+	std::shared_ptr<Tracker> PersonTracker;
+	std::shared_ptr<VoxelGrid> Grid;
+	std::shared_ptr<VoxelClusters> Clustering;	// connected components of the carved voxels
+	std::shared_ptr<GroundPlane> Ground;		// blobs in the top-down occupancy map, associated with the persons
+	std::shared_ptr<VoxelKMeans> Assignment;	// voxels of each person
+	std::shared_ptr<FrameSync> Sync;			// frame sets of the views, aligned by capture time (none when replaying)
+	std::vector<std::shared_ptr<Camera>> Cameras;
+	std::vector<std::shared_ptr<Histogram>> Histograms;
+
+private:
+	bool capture();
+	bool replay();
+
+private:
+	bool ready;
+
+	std::vector<BackgroundModel> backgrounds;
+	std::vector<cv::Rect> regions;		// part of each view that is processed
+	std::shared_ptr<RawFrameReader> rawFrames;	// replaces the videos, the frames are headers on its mapping
+
+	// stand-ins for the frame, mask and carving mask of a missing view
+	cv::Mat blankFrame;
+	cv::Mat blankMask;
+	cv::Mat fullMask;
+
+	std::shared_ptr<RecordingWriter> recording;
+	std::shared_ptr<RecordingReader> replaying;
+	RecordedFrame recorded;
+};
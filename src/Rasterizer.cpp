@@ -0,0 +1,242 @@
+#include "Rasterizer.hpp"
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include <opencv2/opencv.hpp>
+
+#include "Main.hpp"
+
+const int Rasterizer::gridNum = 4;
+const int Rasterizer::gridSize = 480;
+const int Rasterizer::offsetZ = 5;
+const float Rasterizer::nearPlane = 1.f;
+
+// same perspective as the Renderer
+static const float FieldOfView = 54.f;
+static const float FarPlane = 20000.f;
+
+// gray levels of the static geometry
+static cv::Scalar gray(float level) {
+	double c = level * 255.0;
+	return cv::Scalar(c, c, c);
+}
+
+Rasterizer::Rasterizer(int w, int h) :
+ViewAngle(0), ShowVolume(true), ShowFloor(true), ShowCamera(true), ShowOrigin(true), ShowLines(true), ShowBoxes(true),
+width(w), height(h) {
+	depthBuffer = cv::Mat1f(height, width);
+	ResetTopView();
+}
+
+void Rasterizer::CamCoord(std::vector<cv::Point3f> corners) {
+	camCorners.push_back(corners);
+}
+
+void Rasterizer::Volume(std::vector<cv::Point3f> corners) {
+	volumeCorners = corners;
+}
+
+void Rasterizer::LookAt(cv::Point3f e, cv::Point3f u) {
+	eye = e;
+	up = u;
+	updateTransform();
+}
+
+void Rasterizer::ViewIndex(int viewIndex) {
+	if (viewIndex >= 0 && viewIndex < static_cast<int>(camCorners.size())) {
+		LookAt(camCorners[viewIndex][0], cv::Point3f(0, 0, 1));
+	}
+}
+
+void Rasterizer::ResetTopView() {
+	LookAt(cv::Point3f(0, 0, 10000), cv::Point3f(-1, 0, 0));
+}
+
+// Builds the equivalent of gluPerspective, gluLookAt towards the origin and the view rotation around the z-axis.
+void Rasterizer::updateTransform() {
+	cv::Vec3f f = cv::normalize(cv::Vec3f(-eye.x, -eye.y, -eye.z));
+	cv::Vec3f s = cv::normalize(f.cross(cv::Vec3f(up.x, up.y, up.z)));
+	cv::Vec3f u = s.cross(f);
+	cv::Vec3f e(eye.x, eye.y, eye.z);
+
+	cv::Matx44f view(
+		 s[0],  s[1],  s[2], -s.dot(e),
+		 u[0],  u[1],  u[2], -u.dot(e),
+		-f[0], -f[1], -f[2],  f.dot(e),
+		 0.f,   0.f,   0.f,   1.f);
+
+	float a = ViewAngle * castf(CV_PI) / 180.f;
+	cv::Matx44f rotation(
+		std::cos(a), -std::sin(a), 0.f, 0.f,
+		std::sin(a),  std::cos(a), 0.f, 0.f,
+		0.f,          0.f,         1.f, 0.f,
+		0.f,          0.f,         0.f, 1.f);
+
+	float fy = 1.f / std::tan(FieldOfView * castf(CV_PI) / 360.f);
+	float aspect = castf(width) / castf(height);
+	cv::Matx44f projection(
+		fy / aspect, 0.f, 0.f, 0.f,
+		0.f, fy, 0.f, 0.f,
+		0.f, 0.f, (FarPlane + nearPlane) / (nearPlane - FarPlane), (2.f * FarPlane * nearPlane) / (nearPlane - FarPlane),
+		0.f, 0.f, -1.f, 0.f);
+
+	transform = projection * view * rotation;
+}
+
+void Rasterizer::project(cv::Point3f p, cv::Point2f& pixel, float& depth) const {
+	cv::Vec4f c = transform * cv::Vec4f(p.x, p.y, p.z, 1.f);
+	depth = c[3];
+	pixel.x = (c[0] / c[3] + 1.f) * 0.5f * width;
+	pixel.y = (1.f - c[1] / c[3]) * 0.5f * height;
+}
+
+// Draws a line without depth test, clipped against the near plane.
+void Rasterizer::drawLine(cv::Mat& image, cv::Point3f p0, cv::Point3f p1, cv::Scalar color, int thickness) const {
+	cv::Vec4f c0 = transform * cv::Vec4f(p0.x, p0.y, p0.z, 1.f);
+	cv::Vec4f c1 = transform * cv::Vec4f(p1.x, p1.y, p1.z, 1.f);
+
+	if (c0[3] < nearPlane && c1[3] < nearPlane) {
+		return;
+	}
+	if (c0[3] < nearPlane) {
+		c0 += (c1 - c0) * ((nearPlane - c0[3]) / (c1[3] - c0[3]));
+	}
+	else if (c1[3] < nearPlane) {
+		c1 += (c0 - c1) * ((nearPlane - c1[3]) / (c0[3] - c1[3]));
+	}
+
+	cv::Point2f s0((c0[0] / c0[3] + 1.f) * 0.5f * width, (1.f - c0[1] / c0[3]) * 0.5f * height);
+	cv::Point2f s1((c1[0] / c1[3] + 1.f) * 0.5f * width, (1.f - c1[1] / c1[3]) * 0.5f * height);
+
+	// fixed point with 4 fractional bits, for sub-pixel accurate anti-aliased lines
+	cv::line(image,
+		cv::Point(cvRound(s0.x * 16.f), cvRound(s0.y * 16.f)),
+		cv::Point(cvRound(s1.x * 16.f), cvRound(s1.y * 16.f)),
+		color, thickness, cv::LINE_AA, 4);
+}
+
+// Splats every voxel as a 2x2 pixel point, like the renderer's points, with a depth test between voxels.
+void Rasterizer::drawVoxels(cv::Mat& image, std::vector<ColorVertex> const& voxels) {
+	depthBuffer.setTo(FarPlane);
+
+	for (ColorVertex const& v : voxels) {
+		cv::Point2f pixel;
+		float depth;
+		project(cv::Point3f(v.x, v.y, v.z), pixel, depth);
+		if (depth < nearPlane || depth > FarPlane) {
+			continue;
+		}
+
+		int px = casti(std::floor(pixel.x - 0.5f));
+		int py = casti(std::floor(pixel.y - 0.5f));
+		for (int y = std::max(py, 0); y < std::min(py + 2, height); ++y) {
+			float* depthRow = depthBuffer.ptr<float>(y);
+			cv::Vec3b* imageRow = image.ptr<cv::Vec3b>(y);
+			for (int x = std::max(px, 0); x < std::min(px + 2, width); ++x) {
+				if (depth < depthRow[x]) {
+					depthRow[x] = depth;
+					imageRow[x] = cv::Vec3b(v.b, v.g, v.r);
+				}
+			}
+		}
+	}
+}
+
+// Draws lines from the origin of each camera towards the person on the ground plane, as Tracker::DrawLabelLines.
+void Rasterizer::drawLabelLines(cv::Mat& image, std::vector<cv::Point3f> const& positions, cv::Scalar color) const {
+	size_t views = std::min(camCorners.size(), positions.size());
+	for (size_t v = 0; v < views; ++v) {
+		cv::Point2f origin(camCorners[v][0].x, camCorners[v][0].y);
+		cv::Point2f direction = cv::Point2f(positions[v].x, positions[v].y) - origin;
+		float length = castf(cv::norm(direction));
+		if (length <= 0.f) {
+			continue;
+		}
+
+		cv::Point2f end = origin + direction * (8000.f / length);
+		drawLine(image, cv::Point3f(origin.x, origin.y, 0.f), cv::Point3f(end.x, end.y, 0.f), color, 1);
+	}
+}
+
+// Draws a box around a person, as Tracker::DrawLabelGrids.
+void Rasterizer::drawLabelBox(cv::Mat& image, cv::Point3f p, cv::Scalar color) const {
+	const float sizeX = 350.f;
+	const float sizeY = 750.f;
+	const float boxHeight = 2000.f;
+
+	cv::Point3f c[8];
+	for (int i = 0; i < 2; ++i) {
+		float h = i * boxHeight;
+		c[i * 4 + 0] = cv::Point3f(p.x - sizeX, p.y - sizeY, h);
+		c[i * 4 + 1] = cv::Point3f(p.x - sizeX, p.y + sizeY, h);
+		c[i * 4 + 2] = cv::Point3f(p.x + sizeX, p.y + sizeY, h);
+		c[i * 4 + 3] = cv::Point3f(p.x + sizeX, p.y - sizeY, h);
+	}
+
+	for (int i = 0; i < 4; ++i) {
+		drawLine(image, c[i], c[(i + 1) % 4], color, 2);
+		drawLine(image, c[i + 4], c[((i + 1) % 4) + 4], color, 2);
+		drawLine(image, c[i], c[i + 4], color, 2);
+	}
+}
+
+void Rasterizer::Render(FrameSnapshot const& snapshot, cv::Mat& image) {
+	image.create(height, width, CV_8UC3);
+	image.setTo(cv::Scalar(255, 255, 255));
+
+	updateTransform();
+
+	if (ShowCamera) {
+		for (std::vector<cv::Point3f> const& c : camCorners) {
+			for (int j = 1; j <= 4; j++) {
+				drawLine(image, c[0], c[j], gray(0.8f), 1);
+			}
+			for (int j = 1; j <= 4; j++) {
+				drawLine(image, c[j], c[(j % 4) + 1], gray(0.5f), 1);
+			}
+		}
+	}
+
+	if (ShowFloor) {
+		float extent = castf(gridSize * gridNum);
+		for (int g = -gridNum; g <= gridNum; g++) {
+			float offset = castf(g * gridSize);
+			drawLine(image, cv::Point3f(-extent, offset, castf(offsetZ)), cv::Point3f(extent, offset, castf(offsetZ)), gray(0.9f), 1);
+			drawLine(image, cv::Point3f(offset, extent, castf(offsetZ)), cv::Point3f(offset, -extent, castf(offsetZ)), gray(0.9f), 1);
+		}
+	}
+
+	if (ShowVolume && volumeCorners.size() >= 8) {
+		std::vector<cv::Point3f> const& c = volumeCorners;
+		for (int i = 0; i < 4; i++) {
+			drawLine(image, c[i], c[(i + 1) % 4], gray(0.9f), 1);
+			drawLine(image, c[i + 4], c[((i + 1) % 4) + 4], gray(0.9f), 1);
+			drawLine(image, c[i], c[i + 4], gray(0.9f), 1);
+		}
+	}
+
+	drawVoxels(image, snapshot.Voxels);
+
+	if (ShowOrigin) {
+		// x-axis in blue, y-axis in green and z-axis in red
+		drawLine(image, cv::Point3f(0, 0, 0), cv::Point3f(500, 0, 0), cv::Scalar(255, 0, 0), 2);
+		drawLine(image, cv::Point3f(0, 0, 0), cv::Point3f(0, 500, 0), cv::Scalar(0, 255, 0), 2);
+		drawLine(image, cv::Point3f(0, 0, 0), cv::Point3f(0, 0, 500), cv::Scalar(0, 0, 255), 2);
+	}
+
+	if (snapshot.FrameIndex < 0) {
+		return;
+	}
+
+	if (ShowLines) {
+		drawLabelLines(image, snapshot.LinePosWorldA, CV_RGB(0, 200, 0));
+		drawLabelLines(image, snapshot.LinePosWorldB, CV_RGB(0, 0, 200));
+	}
+
+	if (ShowBoxes) {
+		drawLabelBox(image, snapshot.PersonPosA, CV_RGB(0, 200, 0));
+		drawLabelBox(image, snapshot.PersonPosB, CV_RGB(0, 0, 200));
+	}
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "FrameSnapshot.hpp"
+
+// Draws the voxel scene of a snapshot into an image without OpenGL, for rendering on machines without a display.
+// It shows the same geometry as the Renderer: camera frustums, floor grid, volume, origin, voxels and labels.
+class Rasterizer {
+public:
+	Rasterizer(int width, int height);
+
+	// function to get the N camera coordinates
+	void CamCoord(std::vector<cv::Point3f>);
+	// function to set the 8 corners of the acquisition space
+	void Volume(std::vector<cv::Point3f>);
+
+	// camera pose, looking at the origin
+	void LookAt(cv::Point3f eye, cv::Point3f up);
+	void ViewIndex(int);
+	void ResetTopView();
+
+	void Render(FrameSnapshot const&, cv::Mat& image);
+
+public:
+	float ViewAngle;
+
+	bool ShowVolume;
+	bool ShowFloor;
+	bool ShowCamera;
+	bool ShowOrigin;
+	bool ShowLines;
+	bool ShowBoxes;
+
+private:
+	void updateTransform();
+
+	// projects a world point to pixel coordinates, the depth is the distance along the viewing direction
+	void project(cv::Point3f, cv::Point2f& pixel, float& depth) const;
+
+	void drawLine(cv::Mat&, cv::Point3f, cv::Point3f, cv::Scalar color, int thickness) const;
+	void drawVoxels(cv::Mat&, std::vector<ColorVertex> const&);
+	void drawLabelLines(cv::Mat&, std::vector<cv::Point3f> const&, cv::Scalar color) const;
+	void drawLabelBox(cv::Mat&, cv::Point3f, cv::Scalar color) const;
+
+private:
+	static const int gridNum;
+	static const int gridSize;
+	static const int offsetZ;
+	static const float nearPlane;
+
+	int width;
+	int height;
+
+	cv::Point3f eye;
+	cv::Point3f up;
+	cv::Matx44f transform;	// world to clip space
+
+	std::vector<std::vector<cv::Point3f>> camCorners;
+	std::vector<cv::Point3f> volumeCorners;
+
+	cv::Mat1f depthBuffer;
+};
@@ -0,0 +1,293 @@
+#include "RawFrames.hpp"
+
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "BinaryIO.hpp"
+
+static const uint32_t RawFramesMagic = 0x4652424f; // "OBRF"
+static const uint32_t RawFramesVersion = 1;
+
+// offsets of the fields in the header
+static const size_t FrameCountOffset = 20;
+static const size_t HeaderSize = 48;
+
+using namespace BinaryIO;
+
+static uint64_t alignUp(uint64_t bytes, uint64_t alignment) {
+	return (bytes + alignment - 1) / alignment * alignment;
+}
+
+RawFrameWriter::RawFrameWriter() : numViews(0), viewWidth(0), viewHeight(0), frameBytes(0) {
+}
+
+RawFrameWriter::~RawFrameWriter() {
+	Close();
+}
+
+bool RawFrameWriter::Open(std::string const& path, int views, int width, int height, double fps) {
+	file.open(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		std::cerr << "Unable to write frames " << path << std::endl;
+		return false;
+	}
+
+	numViews = views;
+	viewWidth = width;
+	viewHeight = height;
+	frameBytes = alignUp(3ull * width * height, FrameAlignment);
+	times.clear();
+
+	std::vector<uint8_t> header;
+	put(header, RawFramesMagic);
+	put(header, RawFramesVersion);
+	put(header, static_cast<int32_t>(numViews));
+	put(header, static_cast<int32_t>(viewWidth));
+	put(header, static_cast<int32_t>(viewHeight));
+	put(header, static_cast<int32_t>(0)); // frame count, filled in when closing
+	put(header, fps);
+	put(header, frameBytes);
+	put(header, static_cast<uint64_t>(FrameAlignment));
+	header.resize(FrameAlignment, 0);
+
+	file.write(reinterpret_cast<char const*>(header.data()), header.size());
+	padding.assign(frameBytes - 3ull * width * height, 0);
+	return static_cast<bool>(file);
+}
+
+bool RawFrameWriter::Write(std::vector<cv::Mat> const& frames, std::vector<double> const& timestamps) {
+	if (!file.is_open()) {
+		return false;
+	}
+
+	if (static_cast<int>(frames.size()) != numViews || static_cast<int>(timestamps.size()) != numViews) {
+		std::cerr << "Frame set does not have " << numViews << " views" << std::endl;
+		return false;
+	}
+
+	for (cv::Mat const& frame : frames) {
+		if (frame.type() != CV_8UC3 || frame.cols != viewWidth || frame.rows != viewHeight) {
+			std::cerr << "Frame is not " << viewWidth << "x" << viewHeight << " BGR" << std::endl;
+			return false;
+		}
+
+		// frames are written row by row when they are not continuous
+		if (frame.isContinuous()) {
+			file.write(reinterpret_cast<char const*>(frame.data), 3ll * viewWidth * viewHeight);
+		}
+		else {
+			for (int y = 0; y < viewHeight; ++y) {
+				file.write(reinterpret_cast<char const*>(frame.ptr<uint8_t>(y)), 3ll * viewWidth);
+			}
+		}
+		file.write(padding.data(), padding.size());
+	}
+
+	times.insert(times.end(), timestamps.begin(), timestamps.end());
+	return static_cast<bool>(file);
+}
+
+bool RawFrameWriter::Close() {
+	if (!file.is_open()) {
+		return true;
+	}
+
+	// the times follow the frames, the frame count marks the file as complete
+	int32_t frameSets = static_cast<int32_t>(times.size() / numViews);
+	file.write(reinterpret_cast<char const*>(times.data()), times.size() * sizeof(double));
+	file.seekp(FrameCountOffset);
+	file.write(reinterpret_cast<char const*>(&frameSets), sizeof(frameSets));
+
+	bool ok = static_cast<bool>(file);
+	file.close();
+	return ok;
+}
+
+RawFrameReader::RawFrameReader() : data(nullptr), size(0), mapping(nullptr), frameBytes(0), firstFrame(0), times(nullptr), next(0) {
+}
+
+RawFrameReader::~RawFrameReader() {
+	Close();
+}
+
+bool RawFrameReader::Open(std::string const& path) {
+	Close();
+	if (!map(path)) {
+		std::cerr << "Unable to map frames " << path << std::endl;
+		return false;
+	}
+
+	std::vector<uint8_t> header(data, data + std::min(size, HeaderSize));
+	size_t offset = 0;
+	uint32_t magic = 0;
+	uint32_t version = 0;
+	int32_t values[4] = {};
+	get(header, offset, magic);
+	get(header, offset, version);
+	for (int32_t& value : values) {
+		get(header, offset, value);
+	}
+	get(header, offset, Fps);
+	get(header, offset, frameBytes);
+	bool complete = get(header, offset, firstFrame);
+
+	NumViews = values[0];
+	ViewWidth = values[1];
+	ViewHeight = values[2];
+	NumFrames = values[3];
+
+	if (!complete || magic != RawFramesMagic || version != RawFramesVersion || NumViews <= 0 || ViewWidth <= 0 || ViewHeight <= 0 ||
+		frameBytes < 3ull * ViewWidth * ViewHeight || firstFrame < HeaderSize || firstFrame > size) {
+		std::cerr << path << " is not a frame file" << std::endl;
+		Close();
+		return false;
+	}
+
+	// the frame sets of an unfinished file are counted from its size, their times are unknown
+	uint64_t frameSetBytes = frameBytes * NumViews;
+	uint64_t available = (size - firstFrame) / frameSetBytes;
+	uint64_t timesOffset = firstFrame + frameSetBytes * NumFrames;
+	if (NumFrames > 0 && timesOffset + sizeof(double) * NumViews * NumFrames <= size) {
+		times = reinterpret_cast<double const*>(data + timesOffset);
+	}
+	else {
+		if (NumFrames > 0) {
+			std::cerr << "Truncated frame file " << path << std::endl;
+		}
+		NumFrames = static_cast<int>(std::min<uint64_t>(available, NumFrames > 0 ? NumFrames : available));
+		times = nullptr;
+	}
+
+	next = 0;
+	return true;
+}
+
+void RawFrameReader::Close() {
+	unmap();
+	NumViews = 0;
+	ViewWidth = 0;
+	ViewHeight = 0;
+	NumFrames = 0;
+	times = nullptr;
+	next = 0;
+}
+
+cv::Mat RawFrameReader::Frame(int frameSet, int view) const {
+	if (frameSet < 0 || frameSet >= NumFrames || view < 0 || view >= NumViews) {
+		return cv::Mat();
+	}
+
+	uint8_t* frame = data + firstFrame + frameBytes * (static_cast<uint64_t>(frameSet) * NumViews + view);
+	return cv::Mat(ViewHeight, ViewWidth, CV_8UC3, frame);
+}
+
+double RawFrameReader::Timestamp(int frameSet, int view) const {
+	if (times) {
+		return times[static_cast<size_t>(frameSet) * NumViews + view];
+	}
+	return (Fps > 0.0) ? 1000.0 * frameSet / Fps : 0.0;
+}
+
+bool RawFrameReader::Read(std::vector<cv::Mat>& frames, double& timestamp) {
+	if (next >= NumFrames) {
+		return false;
+	}
+
+	frames.resize(NumViews);
+	for (int i = 0; i < NumViews; ++i) {
+		frames[i] = Frame(next, i);
+	}
+	timestamp = Timestamp(next, 0);
+	next++;
+	return true;
+}
+
+// The mapping is private (copy-on-write), so the frames handed out can be written to, like the
+// frames of a capture, without changing the file.
+#ifdef _WIN32
+bool RawFrameReader::map(std::string const& path) {
+	HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (handle == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(handle, &fileSize) || fileSize.QuadPart == 0) {
+		CloseHandle(handle);
+		return false;
+	}
+
+	mapping = CreateFileMappingA(handle, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+	CloseHandle(handle);
+	if (!mapping) {
+		return false;
+	}
+
+	data = static_cast<uint8_t*>(MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0));
+	if (!data) {
+		CloseHandle(mapping);
+		mapping = nullptr;
+		return false;
+	}
+
+	size = static_cast<size_t>(fileSize.QuadPart);
+	return true;
+}
+
+void RawFrameReader::unmap() {
+	if (data) {
+		UnmapViewOfFile(data);
+	}
+	if (mapping) {
+		CloseHandle(mapping);
+	}
+	data = nullptr;
+	mapping = nullptr;
+	size = 0;
+}
+#else
+bool RawFrameReader::map(std::string const& path) {
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat status;
+	if (fstat(fd, &status) != 0 || status.st_size == 0) {
+		close(fd);
+		return false;
+	}
+
+	void* address = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (address == MAP_FAILED) {
+		return false;
+	}
+
+	// frames are read front to back, so the kernel can read ahead
+	madvise(address, static_cast<size_t>(status.st_size), MADV_SEQUENTIAL);
+
+	data = static_cast<uint8_t*>(address);
+	size = static_cast<size_t>(status.st_size);
+	return true;
+}
+
+void RawFrameReader::unmap() {
+	if (data) {
+		munmap(data, size);
+	}
+	data = nullptr;
+	size = 0;
+}
+#endif
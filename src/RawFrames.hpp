@@ -0,0 +1,96 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+
+#include <opencv2/opencv.hpp>
+
+/**
+ * 		Uncompressed multi-view frame file, so a sequence is decoded once and can then be processed
+ * 		again without decoding the videos. The reader maps the file into memory and hands out the
+ * 		frames as cv::Mat headers on the mapping, without copying them.
+ *
+ * 		All values are little-endian. The file starts with a header page, followed by the frames and
+ * 		the capture times:
+ *
+ * 			header		"OBRF", version											uint32, uint32
+ * 						number of views, frame width and height					int32 * 3
+ * 						number of frame sets (0 while writing)					int32
+ * 						frames per second										float64
+ * 						bytes per frame, offset of the first frame				uint64, uint64
+ * 						zero padding up to the first frame
+ * 			frames		per frame set, per view: BGR8 pixels in row order		uint8 * 3 * width * height
+ * 						zero padding up to the bytes per frame
+ * 			times		per frame set, per view: capture time in milliseconds	float64 * views
+ *
+ * 		Every frame starts at a multiple of FrameAlignment bytes, so it is page aligned in the
+ * 		mapping. A file that was not closed properly has no frame count and no times: its frame sets
+ * 		are counted from the file size and their times follow from the frame rate.
+ */
+
+class RawFrameWriter {
+public:
+	RawFrameWriter();
+	~RawFrameWriter();
+
+public:
+	bool Open(std::string const& path, int views, int width, int height, double fps);
+	bool Write(std::vector<cv::Mat> const& frames, std::vector<double> const& timestamps);	// one BGR frame and capture time per view
+	bool Close();
+
+public:
+	static const size_t FrameAlignment = 4096;
+
+private:
+	std::ofstream file;
+
+	int numViews;
+	int viewWidth;
+	int viewHeight;
+	uint64_t frameBytes;
+	std::vector<double> times;
+	std::vector<char> padding;
+};
+
+class RawFrameReader {
+public:
+	RawFrameReader();
+	~RawFrameReader();
+
+	RawFrameReader(RawFrameReader const&) = delete;
+	RawFrameReader& operator=(RawFrameReader const&) = delete;
+
+public:
+	bool Open(std::string const& path);
+	void Close();
+
+	// frame of a view as a header on the mapping (valid until the reader is closed); writing to it
+	// copies the touched pages, the file is never changed
+	cv::Mat Frame(int frameSet, int view) const;
+	double Timestamp(int frameSet, int view) const;	// capture time in milliseconds
+
+	bool Read(std::vector<cv::Mat>& frames, double& timestamp);	// next frame set, returns false at the end
+
+public:
+	int NumViews = 0;
+	int ViewWidth = 0;
+	int ViewHeight = 0;
+	int NumFrames = 0;
+	double Fps = 0.0;
+
+private:
+	bool map(std::string const& path);
+	void unmap();
+
+private:
+	uint8_t* data;
+	size_t size;
+	void* mapping;		// handle of the file mapping (Windows only)
+
+	uint64_t frameBytes;
+	uint64_t firstFrame;
+	double const* times;	// capture times in the mapping, nullptr when the file was not closed
+	int next;
+};
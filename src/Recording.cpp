@@ -0,0 +1,242 @@
+#include "Recording.hpp"
+
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+
+#include "BinaryIO.hpp"
+
+static const uint32_t RecordingMagic = 0x4352424f; // "OBRC"
+static const uint32_t RecordingVersion = 2;
+
+// records are written once this many bytes are buffered
+static const size_t FlushSize = 4 << 20;
+
+using namespace BinaryIO;
+
+RecordingWriter::RecordingWriter() : numViews(0), viewWidth(0), viewHeight(0) {
+	buffer.reserve(2 * FlushSize);
+}
+
+RecordingWriter::~RecordingWriter() {
+	Close();
+}
+
+bool RecordingWriter::Open(std::string const& path, int views, int width, int height, int voxels) {
+	file.open(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		std::cerr << "Unable to write recording " << path << std::endl;
+		return false;
+	}
+
+	numViews = views;
+	viewWidth = width;
+	viewHeight = height;
+
+	buffer.clear();
+	put(buffer, RecordingMagic);
+	put(buffer, RecordingVersion);
+	put(buffer, static_cast<int32_t>(numViews));
+	put(buffer, static_cast<int32_t>(viewWidth));
+	put(buffer, static_cast<int32_t>(viewHeight));
+	put(buffer, static_cast<int32_t>(voxels));
+	return true;
+}
+
+bool RecordingWriter::Write(int frameIndex, double timestamp, std::vector<cv::Mat> const& masks,
+	std::vector<cv::Mat> const& frames, std::vector<int> const& voxels, std::vector<FrameStatus> const& status) {
+	if (!file.is_open()) {
+		return false;
+	}
+
+	size_t start = buffer.size();
+	put(buffer, static_cast<uint32_t>(0)); // size, filled in below
+	put(buffer, static_cast<int32_t>(frameIndex));
+	put(buffer, timestamp);
+
+	sorted.assign(voxels.begin(), voxels.end());
+	std::sort(sorted.begin(), sorted.end());
+	put(buffer, static_cast<uint32_t>(sorted.size()));
+	int previous = 0;
+	for (int v : sorted) {
+		putVarint(buffer, static_cast<uint32_t>(v - previous));
+		previous = v;
+	}
+
+	for (int i = 0; i < numViews; ++i) {
+		cv::Mat const& mask = masks[i];
+		cv::Mat const& frame = frames[i];
+		put(buffer, static_cast<uint8_t>((i < static_cast<int>(status.size())) ? status[i] : FRAME_CURRENT));
+
+		runs.clear();
+		colors.clear();
+		bool foreground = false;
+		uint32_t run = 0;
+		for (int y = 0; y < viewHeight; ++y) {
+			uint8_t const* maskRow = mask.ptr<uint8_t>(y);
+			cv::Vec3b const* frameRow = frame.ptr<cv::Vec3b>(y);
+			for (int x = 0; x < viewWidth; ++x) {
+				bool set = maskRow[x] != 0;
+				if (set != foreground) {
+					putVarint(runs, run);
+					foreground = set;
+					run = 0;
+				}
+				run++;
+
+				if (set) {
+					colors.push_back(frameRow[x][0]);
+					colors.push_back(frameRow[x][1]);
+					colors.push_back(frameRow[x][2]);
+				}
+			}
+		}
+		putVarint(runs, run);
+
+		put(buffer, static_cast<uint32_t>(runs.size()));
+		buffer.insert(buffer.end(), runs.begin(), runs.end());
+		buffer.insert(buffer.end(), colors.begin(), colors.end());
+	}
+
+	uint32_t size = static_cast<uint32_t>(buffer.size() - start - sizeof(uint32_t));
+	std::memcpy(buffer.data() + start, &size, sizeof(size));
+
+	if (buffer.size() >= FlushSize) {
+		return flush();
+	}
+	return true;
+}
+
+bool RecordingWriter::flush() {
+	file.write(reinterpret_cast<char const*>(buffer.data()), buffer.size());
+	buffer.clear();
+	return static_cast<bool>(file);
+}
+
+bool RecordingWriter::Close() {
+	if (!file.is_open()) {
+		return true;
+	}
+
+	bool ok = flush();
+	file.close();
+	return ok;
+}
+
+bool RecordingReader::Open(std::string const& path) {
+	file.open(path, std::ios::binary);
+	if (!file.is_open()) {
+		std::cerr << "Unable to open recording " << path << std::endl;
+		return false;
+	}
+
+	uint32_t magic = 0;
+	int32_t values[4];
+	read(file, magic);
+	read(file, version);
+	file.read(reinterpret_cast<char*>(values), sizeof(values));
+	if (!file || magic != RecordingMagic || version < 1 || version > RecordingVersion) {
+		std::cerr << path << " is not a recording" << std::endl;
+		return false;
+	}
+
+	NumViews = values[0];
+	ViewWidth = values[1];
+	ViewHeight = values[2];
+	NumVoxels = values[3];
+	return true;
+}
+
+bool RecordingReader::Read(RecordedFrame& frame) {
+	uint32_t size = 0;
+	if (!read(file, size)) {
+		return false;
+	}
+
+	record.resize(size);
+	file.read(reinterpret_cast<char*>(record.data()), size);
+	if (!file) {
+		std::cerr << "Truncated recording" << std::endl;
+		return false;
+	}
+
+	size_t offset = 0;
+	int32_t frameIndex = 0;
+	uint32_t count = 0;
+	get(record, offset, frameIndex);
+	get(record, offset, frame.Timestamp);
+	get(record, offset, count);
+	frame.FrameIndex = frameIndex;
+
+	frame.Voxels.resize(count);
+	uint32_t index = 0;
+	for (uint32_t i = 0; i < count; ++i) {
+		uint32_t delta = 0;
+		if (!getVarint(record, offset, delta) || index + delta >= static_cast<uint32_t>(NumVoxels)) {
+			std::cerr << "Corrupt recording" << std::endl;
+			return false;
+		}
+		index += delta;
+		frame.Voxels[i] = static_cast<int>(index);
+	}
+
+	frame.Masks.resize(NumViews);
+	frame.Foregrounds.resize(NumViews);
+	frame.Status.assign(NumViews, FRAME_CURRENT);
+	for (int i = 0; i < NumViews; ++i) {
+		cv::Mat& mask = frame.Masks[i];
+		cv::Mat& foreground = frame.Foregrounds[i];
+		mask.create(ViewHeight, ViewWidth, CV_8U);
+		foreground.create(ViewHeight, ViewWidth, CV_8UC3);
+
+		uint8_t status = FRAME_CURRENT;
+		if (version >= 2 && (!get(record, offset, status) || status > FRAME_MISSING)) {
+			std::cerr << "Corrupt recording" << std::endl;
+			return false;
+		}
+		frame.Status[i] = static_cast<FrameStatus>(status);
+
+		uint32_t runsSize = 0;
+		if (!get(record, offset, runsSize) || offset + runsSize > record.size()) {
+			std::cerr << "Corrupt recording" << std::endl;
+			return false;
+		}
+		size_t runsEnd = offset + runsSize;
+		size_t colorOffset = runsEnd;
+
+		// both images are continuous, so the runs can be written across rows
+		uint8_t* maskData = mask.ptr<uint8_t>();
+		uint8_t* foregroundData = foreground.ptr<uint8_t>();
+		size_t total = static_cast<size_t>(ViewWidth) * ViewHeight;
+		size_t pixel = 0;
+		bool set = false;
+		while (offset < runsEnd) {
+			uint32_t run = 0;
+			if (!getVarint(record, offset, run) || pixel + run > total ||
+				(set && colorOffset + 3 * static_cast<size_t>(run) > record.size())) {
+				std::cerr << "Corrupt recording" << std::endl;
+				return false;
+			}
+
+			if (set) {
+				std::memset(maskData + pixel, 255, run);
+				std::memcpy(foregroundData + 3 * pixel, record.data() + colorOffset, 3 * static_cast<size_t>(run));
+				colorOffset += 3 * static_cast<size_t>(run);
+			}
+			else {
+				std::memset(maskData + pixel, 0, run);
+				std::memset(foregroundData + 3 * pixel, 0, 3 * static_cast<size_t>(run));
+			}
+			pixel += run;
+			set = !set;
+		}
+
+		if (pixel != total) {
+			std::cerr << "Corrupt recording" << std::endl;
+			return false;
+		}
+		offset = colorOffset;
+	}
+
+	return true;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+
+#include <opencv2/opencv.hpp>
+
+#include "FrameSync.hpp"
+
+/**
+ * 		Recording of the inputs of the tracker, so tracking can be re-run without decoding the
+ * 		videos, subtracting the backgrounds and carving the voxels again.
+ *
+ * 		The file starts with a header ("OBRC", version, number of views, view width and height,
+ * 		number of voxels), followed by one record per frame:
+ *
+ * 			size of the rest of the record								uint32
+ * 			frame index, timestamp in milliseconds						int32, float64
+ * 			number of occupied voxels, their sorted indices				uint32, varint differences
+ * 			per view:	frame status (see FrameStatus)					uint8
+ * 						size of the mask runs							uint32
+ * 						mask runs										varints
+ * 						colors of the foreground pixels					uint8 * 3 * foreground pixels
+ *
+ * 		The runs alternate between background and foreground, starting with background, in row
+ * 		order. The colors are stored in the same order as the foreground pixels. Version 1 recordings
+ * 		have no frame status, all their views are current.
+ */
+
+// Tracker inputs of a single frame.
+struct RecordedFrame {
+	int FrameIndex = 0;
+	double Timestamp = 0.0;
+	std::vector<cv::Mat> Masks;			// foreground masks (0 or 255)
+	std::vector<cv::Mat> Foregrounds;	// colors under the masks, black elsewhere
+	std::vector<int> Voxels;			// sorted indices of the occupied voxels
+	std::vector<FrameStatus> Status;	// of each view in the frame set
+};
+
+class RecordingWriter {
+public:
+	RecordingWriter();
+	~RecordingWriter();
+
+public:
+	bool Open(std::string const& path, int views, int width, int height, int voxels);
+	bool Write(int frameIndex, double timestamp, std::vector<cv::Mat> const& masks,
+		std::vector<cv::Mat> const& frames, std::vector<int> const& voxels,
+		std::vector<FrameStatus> const& status = {});	// views without a status are current
+	bool Close();
+
+private:
+	bool flush();
+
+private:
+	std::ofstream file;
+
+	int numViews;
+	int viewWidth;
+	int viewHeight;
+
+	std::vector<uint8_t> buffer;	// records are collected and written in large blocks
+	std::vector<uint8_t> runs;
+	std::vector<uint8_t> colors;
+	std::vector<int> sorted;
+};
+
+class RecordingReader {
+public:
+	bool Open(std::string const& path);
+	bool Read(RecordedFrame&);		// returns false at the end of the recording
+
+public:
+	int NumViews = 0;
+	int ViewWidth = 0;
+	int ViewHeight = 0;
+	int NumVoxels = 0;
+
+private:
+	std::ifstream file;
+	uint32_t version = 0;
+	std::vector<uint8_t> record;
+};
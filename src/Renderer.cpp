@@ -1,8 +1,11 @@
 #include "Renderer.hpp"
 
+#include <cmath>
 #include <vector>
+#include <cstddef>
 #include <fstream>
 #include <iostream>
+#include <algorithm>
 
 #include <GL/freeglut.h>
 #include <opencv2/opencv.hpp>
@@ -18,14 +21,42 @@ float Renderer::eyeZ = 10000;
 unsigned int Renderer::width = 644;
 unsigned int Renderer::height = 484;
 
+// vertex buffer object functions, loaded at runtime
+#ifndef GL_ARRAY_BUFFER
+#define GL_ARRAY_BUFFER 0x8892
+#define GL_STREAM_DRAW 0x88E0
+#define GL_STATIC_DRAW 0x88E4
+#endif
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+typedef void (APIENTRY *GenBuffersProc)(GLsizei, GLuint*);
+typedef void (APIENTRY *BindBufferProc)(GLenum, GLuint);
+typedef void (APIENTRY *BufferDataProc)(GLenum, std::ptrdiff_t, void const*, GLenum);
+typedef void (APIENTRY *BufferSubDataProc)(GLenum, std::ptrdiff_t, std::ptrdiff_t, void const*);
+
+static GenBuffersProc vboGenBuffers = nullptr;
+static BindBufferProc vboBindBuffer = nullptr;
+static BufferDataProc vboBufferData = nullptr;
+static BufferSubDataProc vboBufferSubData = nullptr;
+
 Renderer::Renderer(int vN) : 
-numViews(vN), currentView(-1), NumFrames(0), ViewAngle(0), CameraView(false), 
-ShowVolume(true), ShowFloor(true), ShowCamera(true), ShowOrigin(true) {
+NumFrames(0), ViewAngle(0), CameraView(false), 
+ShowVolume(true), ShowFloor(true), ShowCamera(true), ShowOrigin(true), numViews(vN), currentView(-1), 
+buffersReady(false), staticDirty(true), staticBuffer(0), voxelBuffer(0), voxelCapacity(0), voxelFrame(-1) {
 	initGrid();
 }
 
 void Renderer::CamCoord(std::vector<cv::Point3f> camIndex) {
 	camCorners.push_back(camIndex);
+	staticDirty = true;
+}
+
+void Renderer::Volume(std::vector<cv::Point3f> corners) {
+	volumeCorners = corners;
+	staticDirty = true;
 }
 
 void Renderer::ViewIndex(int viewIndex) {
@@ -100,192 +131,155 @@ void Renderer::initGrid() {
 	gridEdges.push_back(edge4);
 }
 
-void Renderer::drawGrid() {
-	glLineWidth(1.0f);
-	glPushMatrix();
-	//glTranslatef(0, 4, 0);
-	glBegin(GL_LINES);
+// Loads the vertex buffer object functions (OpenGL 1.5), which are not exported by every OpenGL library.
+void Renderer::initBuffers() {
+	buffersReady = true;
+
+	vboGenBuffers = reinterpret_cast<GenBuffersProc>(glutGetProcAddress("glGenBuffers"));
+	vboBindBuffer = reinterpret_cast<BindBufferProc>(glutGetProcAddress("glBindBuffer"));
+	vboBufferData = reinterpret_cast<BufferDataProc>(glutGetProcAddress("glBufferData"));
+	vboBufferSubData = reinterpret_cast<BufferSubDataProc>(glutGetProcAddress("glBufferSubData"));
+
+	if (!vboGenBuffers || !vboBindBuffer || !vboBufferData || !vboBufferSubData) {
+		std::cout << "Vertex buffer objects unavailable, drawing from client memory" << std::endl;
+		return;
+	}
+
+	vboGenBuffers(1, &staticBuffer);
+	vboGenBuffers(1, &voxelBuffer);
+}
+
+void Renderer::addLine(cv::Point3f p0, cv::Point3f p1, float gray, float alpha) {
+	uint8_t c = static_cast<uint8_t>(gray * 255.f);
+	uint8_t a = static_cast<uint8_t>(alpha * 255.f);
+	staticVertices.push_back({ p0.x, p0.y, p0.z, c, c, c, a });
+	staticVertices.push_back({ p1.x, p1.y, p1.z, c, c, c, a });
+}
 
+void Renderer::addGrid() {
 	int gSize = gridNum * 2 + 1;
 	for (int g = 0; g < gSize; g++) {
 		// y lines
-		glColor4f(0.9f, 0.9f, 0.9f, 0.5f);
-		glVertex3f(gridEdges[0][g].x, gridEdges[0][g].y, gridEdges[0][g].z);
-		glVertex3f(gridEdges[2][g].x, gridEdges[2][g].y, gridEdges[2][g].z);
+		addLine(gridEdges[0][g], gridEdges[2][g], 0.9f, 0.5f);
 		// x lines
-		glColor4f(0.9f, 0.9f, 0.9f, 0.5f);
-		glVertex3f(gridEdges[1][g].x, gridEdges[1][g].y, gridEdges[1][g].z);
-		glVertex3f(gridEdges[3][g].x, gridEdges[3][g].y, gridEdges[3][g].z);
+		addLine(gridEdges[1][g], gridEdges[3][g], 0.9f, 0.5f);
 	}
-
-	glEnd();
-	glPopMatrix();
 }
 
-void Renderer::drawVolume(std::shared_ptr<VoxelGrid> vr) {
-	glLineWidth(1.0f);
-	glPushMatrix();
-	glBegin(GL_LINES);
-
-	// bottom
-	glColor4f(0.9f, 0.9f, 0.9f, 0.5f);
-	glVertex3f(vr->volumeCorners[0].x, vr->volumeCorners[0].y, vr->volumeCorners[0].z);
-	glVertex3f(vr->volumeCorners[1].x, vr->volumeCorners[1].y, vr->volumeCorners[1].z);
-
-	glColor4f(0.9f, 0.9f, 0.9f, 0.5f);
-	glVertex3f(vr->volumeCorners[1].x, vr->volumeCorners[1].y, vr->volumeCorners[1].z);
-	glVertex3f(vr->volumeCorners[2].x, vr->volumeCorners[2].y, vr->volumeCorners[2].z);
-
-	glColor4f(0.9f, 0.9f, 0.9f, 0.5f);
-	glVertex3f(vr->volumeCorners[2].x, vr->volumeCorners[2].y, vr->volumeCorners[2].z);
-	glVertex3f(vr->volumeCorners[3].x, vr->volumeCorners[3].y, vr->volumeCorners[3].z);
-
-	glColor4f(0.9f, 0.9f, 0.9f, 0.5f);
-	glVertex3f(vr->volumeCorners[3].x, vr->volumeCorners[3].y, vr->volumeCorners[3].z);
-	glVertex3f(vr->volumeCorners[0].x, vr->volumeCorners[0].y, vr->volumeCorners[0].z);
-
-	// top
-	glColor4f(0.9f, 0.9f, 0.9f, 0.5f);
-	glVertex3f(vr->volumeCorners[4].x, vr->volumeCorners[4].y, vr->volumeCorners[4].z);
-	glVertex3f(vr->volumeCorners[5].x, vr->volumeCorners[5].y, vr->volumeCorners[5].z);
-
-	glColor4f(0.9f, 0.9f, 0.9f, 0.5f);
-	glVertex3f(vr->volumeCorners[5].x, vr->volumeCorners[5].y, vr->volumeCorners[5].z);
-	glVertex3f(vr->volumeCorners[6].x, vr->volumeCorners[6].y, vr->volumeCorners[6].z);
+void Renderer::addVolume() {
+	std::vector<cv::Point3f> const& c = volumeCorners;
+	if (c.size() < 8) {
+		return;
+	}
 
-	glColor4f(0.9f, 0.9f, 0.9f, 0.5f);
-	glVertex3f(vr->volumeCorners[6].x, vr->volumeCorners[6].y, vr->volumeCorners[6].z);
-	glVertex3f(vr->volumeCorners[7].x, vr->volumeCorners[7].y, vr->volumeCorners[7].z);
+	for (int i = 0; i < 4; i++) {
+		// bottom
+		addLine(c[i], c[(i + 1) % 4], 0.9f, 0.5f);
+		// top
+		addLine(c[i + 4], c[((i + 1) % 4) + 4], 0.9f, 0.5f);
+		// connection
+		addLine(c[i], c[i + 4], 0.9f, 0.5f);
+	}
+}
 
-	glColor4f(0.9f, 0.9f, 0.9f, 0.5f);
-	glVertex3f(vr->volumeCorners[7].x, vr->volumeCorners[7].y, vr->volumeCorners[7].z);
-	glVertex3f(vr->volumeCorners[4].x, vr->volumeCorners[4].y, vr->volumeCorners[4].z);
+void Renderer::addCamCoord() {
+	for (int i = 0; i < numViews; i++) {
+		std::vector<cv::Point3f> const& c = camCorners[i];
 
-	// connection
-	glColor4f(0.9f, 0.9f, 0.9f, 0.5f);
-	glVertex3f(vr->volumeCorners[0].x, vr->volumeCorners[0].y, vr->volumeCorners[0].z);
-	glVertex3f(vr->volumeCorners[4].x, vr->volumeCorners[4].y, vr->volumeCorners[4].z);
+		// projection center to image plane corners
+		for (int j = 1; j <= 4; j++) {
+			addLine(c[0], c[j], 0.8f, 0.5f);
+		}
 
-	glColor4f(0.9f, 0.9f, 0.9f, 0.5f);
-	glVertex3f(vr->volumeCorners[1].x, vr->volumeCorners[1].y, vr->volumeCorners[1].z);
-	glVertex3f(vr->volumeCorners[5].x, vr->volumeCorners[5].y, vr->volumeCorners[5].z);
+		// image plane
+		for (int j = 1; j <= 4; j++) {
+			addLine(c[j], c[(j % 4) + 1], 0.5f, 0.5f);
+		}
+	}
+}
 
-	glColor4f(0.9f, 0.9f, 0.9f, 0.5f);
-	glVertex3f(vr->volumeCorners[2].x, vr->volumeCorners[2].y, vr->volumeCorners[2].z);
-	glVertex3f(vr->volumeCorners[6].x, vr->volumeCorners[6].y, vr->volumeCorners[6].z);
+void Renderer::addOrigin() {
+	// x-axis in blue, y-axis in green and z-axis in red
+	staticVertices.push_back({ 0.f, 0.f, 0.f, 0, 0, 255, 127 });
+	staticVertices.push_back({ 500.f, 0.f, 0.f, 0, 0, 255, 127 });
+	staticVertices.push_back({ 0.f, 0.f, 0.f, 0, 255, 0, 127 });
+	staticVertices.push_back({ 0.f, 500.f, 0.f, 0, 255, 0, 127 });
+	staticVertices.push_back({ 0.f, 0.f, 0.f, 255, 0, 0, 127 });
+	staticVertices.push_back({ 0.f, 0.f, 500.f, 255, 0, 0, 127 });
+}
 
-	glColor4f(0.9f, 0.9f, 0.9f, 0.5f);
-	glVertex3f(vr->volumeCorners[3].x, vr->volumeCorners[3].y, vr->volumeCorners[3].z);
-	glVertex3f(vr->volumeCorners[7].x, vr->volumeCorners[7].y, vr->volumeCorners[7].z);
+// Collects the camera frustums, floor grid, volume and origin, and uploads them once.
+void Renderer::buildStaticGeometry() {
+	staticVertices.clear();
 
-	glEnd();
-	glPopMatrix();
-}
+	camCoordRange.first = static_cast<int>(staticVertices.size());
+	addCamCoord();
+	camCoordRange.count = static_cast<int>(staticVertices.size()) - camCoordRange.first;
 
-void Renderer::drawVoxels(std::shared_ptr<VoxelGrid> vr) {
-	glPushMatrix();
+	gridRange.first = static_cast<int>(staticVertices.size());
+	addGrid();
+	gridRange.count = static_cast<int>(staticVertices.size()) - gridRange.first;
 
-	// apply default translation
-	glTranslatef(0, 0, 0);
-	glPointSize(2.0f);
-	glBegin(GL_POINTS);
+	volumeRange.first = static_cast<int>(staticVertices.size());
+	addVolume();
+	volumeRange.count = static_cast<int>(staticVertices.size()) - volumeRange.first;
 
-	int vSize = int(vr->visibleVoxels.size());
+	originRange.first = static_cast<int>(staticVertices.size());
+	addOrigin();
+	originRange.count = static_cast<int>(staticVertices.size()) - originRange.first;
 
-	for (int v = 0; v < vSize; v++) {
-		glColor4f(
-			vr->visibleVoxels[v].r / 256, 
-			vr->visibleVoxels[v].g / 256, 
-			vr->visibleVoxels[v].b / 256, 
-			1.0f
-		);
-		glVertex3f(
-			static_cast<float>(vr->visibleVoxels[v].x),
-			static_cast<float>(vr->visibleVoxels[v].y),
-			static_cast<float>(vr->visibleVoxels[v].z)
-		);
+	if (staticBuffer) {
+		vboBindBuffer(GL_ARRAY_BUFFER, staticBuffer);
+		vboBufferData(GL_ARRAY_BUFFER, staticVertices.size() * sizeof(ColorVertex), staticVertices.data(), GL_STATIC_DRAW);
+		vboBindBuffer(GL_ARRAY_BUFFER, 0);
 	}
 
-	glEnd();
-	glPopMatrix();
+	staticDirty = false;
 }
 
-void Renderer::drawCamCoord() {
-	glLineWidth(1.0f);
-	glPushMatrix();
-	glBegin(GL_LINES);
+// Points the vertex and color arrays at a buffer object, or at client memory if there is none.
+static void bindVertices(GLuint buffer, ColorVertex const* vertices) {
+	char const* base = buffer ? nullptr : reinterpret_cast<char const*>(vertices);
 
-	for (int i = 0; i < numViews; i++) {
-		// 0 - 1
-		glColor4f(0.8f, 0.8f, 0.8f, 0.5f);
-		glVertex3f(camCorners[i][0].x, camCorners[i][0].y, camCorners[i][0].z);
-		glVertex3f(camCorners[i][1].x, camCorners[i][1].y, camCorners[i][1].z);
-
-		// 0 - 2
-		glColor4f(0.8f, 0.8f, 0.8f, 0.5f);
-		glVertex3f(camCorners[i][0].x, camCorners[i][0].y, camCorners[i][0].z);
-		glVertex3f(camCorners[i][2].x, camCorners[i][2].y, camCorners[i][2].z);
-
-		// 0 - 3
-		glColor4f(0.8f, 0.8f, 0.8f, 0.5f);
-		glVertex3f(camCorners[i][0].x, camCorners[i][0].y, camCorners[i][0].z);
-		glVertex3f(camCorners[i][3].x, camCorners[i][3].y, camCorners[i][3].z);
-
-		// 0 - 4
-		glColor4f(0.8f, 0.8f, 0.8f, 0.5f);
-		glVertex3f(camCorners[i][0].x, camCorners[i][0].y, camCorners[i][0].z);
-		glVertex3f(camCorners[i][4].x, camCorners[i][4].y, camCorners[i][4].z);
-
-		// 1 - 2
-		glColor4f(0.5f, 0.5f, 0.5f, 0.5f);
-		glVertex3f(camCorners[i][1].x, camCorners[i][1].y, camCorners[i][1].z);
-		glVertex3f(camCorners[i][2].x, camCorners[i][2].y, camCorners[i][2].z);
-
-		// 2 - 3
-		glColor4f(0.5f, 0.5f, 0.5f, 0.5f);
-		glVertex3f(camCorners[i][2].x, camCorners[i][2].y, camCorners[i][2].z);
-		glVertex3f(camCorners[i][3].x, camCorners[i][3].y, camCorners[i][3].z);
-
-		// 3 - 4
-		glColor4f(0.5f, 0.5f, 0.5f, 0.5f);
-		glVertex3f(camCorners[i][3].x, camCorners[i][3].y, camCorners[i][3].z);
-		glVertex3f(camCorners[i][4].x, camCorners[i][4].y, camCorners[i][4].z);
-
-		// 4 - 1
-		glColor4f(0.5f, 0.5f, 0.5f, 0.5f);
-		glVertex3f(camCorners[i][4].x, camCorners[i][4].y, camCorners[i][4].z);
-		glVertex3f(camCorners[i][1].x, camCorners[i][1].y, camCorners[i][1].z);
+	if (vboBindBuffer) {
+		vboBindBuffer(GL_ARRAY_BUFFER, buffer);
 	}
-
-	glEnd();
-	glPopMatrix();
+	glVertexPointer(3, GL_FLOAT, sizeof(ColorVertex), base + offsetof(ColorVertex, x));
+	glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(ColorVertex), base + offsetof(ColorVertex, r));
 }
 
-void Renderer::drawOrigin() {
-	glLineWidth(1.5f);
-	glPushMatrix();
-	glBegin(GL_LINES);
+void Renderer::drawLines(VertexRange range, float width) {
+	glLineWidth(width);
+	glDrawArrays(GL_LINES, range.first, range.count);
+}
 
-	// draw x-axis
-	glColor4f(0.0f, 0.0f, 1.0f, 0.5f);
-	glVertex3f(0.0f, 0.0f, 0.0f);
-	glVertex3f(500.0f, 0.0f, 0.0f);
+void Renderer::drawVoxels(FrameSnapshot const& snapshot) {
+	std::vector<ColorVertex> const& voxels = snapshot.Voxels;
+	int vSize = int(voxels.size());
+	if (vSize == 0) {
+		return;
+	}
 
-	// draw y-axis
-	glColor4f(0.0f, 1.0f, 0.0f, 0.5f);
-	glVertex3f(0.0f, 0.0f, 0.0f);
-	glVertex3f(0.0f, 500.0f, 0.0f);
+	// the scene is redrawn more often than frames are processed, upload each frame once;
+	// orphan the buffer every frame so the driver does not have to wait for the previous draw
+	if (voxelBuffer && voxelFrame != snapshot.FrameIndex) {
+		size_t bytes = vSize * sizeof(ColorVertex);
+		vboBindBuffer(GL_ARRAY_BUFFER, voxelBuffer);
+		if (bytes > voxelCapacity) {
+			voxelCapacity = std::max(bytes, voxelCapacity * 2);
+		}
+		vboBufferData(GL_ARRAY_BUFFER, voxelCapacity, nullptr, GL_STREAM_DRAW);
+		vboBufferSubData(GL_ARRAY_BUFFER, 0, bytes, voxels.data());
+		voxelFrame = snapshot.FrameIndex;
+	}
 
-	// draw z-axis
-	glColor4f(1.0f, 0.0f, 0.0f, 0.5f);
-	glVertex3f(0.0f, 0.0f, 0.0f);
-	glVertex3f(0.0f, 0.0f, 500.0f);
+	bindVertices(voxelBuffer, voxels.data());
 
-	glEnd();
-	glPopMatrix();
+	glPointSize(2.0f);
+	glDrawArrays(GL_POINTS, 0, vSize);
 }
 
-void Renderer::Render(std::shared_ptr<VoxelGrid> vr) {
+void Renderer::Render(FrameSnapshot const& snapshot) {
 	glEnable(GL_DEPTH_TEST);
 
 	// Here's our rendering. Clears the screen to black, clear the color and
@@ -316,21 +310,40 @@ void Renderer::Render(std::shared_ptr<VoxelGrid> vr) {
 	glRotatef(ViewAngle, 0.0f, 0.0f, 1.0f);
 	glPopMatrix();
 
+	if (!buffersReady) {
+		initBuffers();
+	}
+	if (staticDirty) {
+		buildStaticGeometry();
+	}
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+
+	bindVertices(staticBuffer, staticVertices.data());
+
 	if (ShowCamera) {
-		drawCamCoord();
+		drawLines(camCoordRange, 1.0f);
 	}
 	if (ShowFloor) {
-		drawGrid();
+		drawLines(gridRange, 1.0f);
 	}
 	if (ShowVolume) {
-		drawVolume(vr);
+		drawLines(volumeRange, 1.0f);
 	}
 
-	drawVoxels(vr);
+	drawVoxels(snapshot);
 
 	if (ShowOrigin) {
-		drawOrigin();
+		bindVertices(staticBuffer, staticVertices.data());
+		drawLines(originRange, 1.5f);
+	}
+
+	if (vboBindBuffer) {
+		vboBindBuffer(GL_ARRAY_BUFFER, 0);
 	}
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
 }
 
 void Renderer::Flush() {
@@ -376,7 +389,7 @@ void Renderer::MoveScene(int x, int y) {
 }
 
 void Renderer::Zoom(int zDelta) {
-	float n = std::sqrtf(eyeX*eyeX + eyeY*eyeY + eyeZ*eyeZ);
+	float n = std::sqrt(eyeX*eyeX + eyeY*eyeY + eyeZ*eyeZ);
 
 	if (zDelta > 0) {
 		eyeX += (eyeX / n) * 500;
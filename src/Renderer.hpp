@@ -6,7 +6,13 @@
 #include <GL/freeglut.h>
 #include <opencv2/opencv.hpp>
 
-#include "VoxelGrid.hpp"
+#include "FrameSnapshot.hpp"
+
+// Range of vertices in a vertex buffer.
+struct VertexRange {
+	int first = 0;
+	int count = 0;
+};
 
 class Renderer {
 public:
@@ -15,10 +21,12 @@ public:
 
 	// function to get the N camera coordinates
 	void CamCoord(std::vector<cv::Point3f>);
+	// function to set the 8 corners of the acquisition space
+	void Volume(std::vector<cv::Point3f>);
 	void ViewIndex(int);
 	void ResetTopView();
 
-	void Render(std::shared_ptr<VoxelGrid>);
+	void Render(FrameSnapshot const&);
 	void Flush();
 
     void MoveScene(int x, int y);
@@ -31,14 +39,20 @@ public:
 private:
 	// function to calculate and display the ground floor grid and volume
 	void initGrid();
+	void initBuffers();
 
-	void drawGrid();
-	void drawVolume(std::shared_ptr<VoxelGrid>);
-	void drawOrigin();
+	// static geometry is built once into its own vertex buffer
+	void buildStaticGeometry();
+	void addGrid();
+	void addVolume();
+	void addOrigin();
+	void addCamCoord();
+	void addLine(cv::Point3f, cv::Point3f, float gray, float alpha);
+
+	void drawLines(VertexRange, float width);
 
 	// function to draw voxels
-	void drawVoxels(std::shared_ptr<VoxelGrid>);
-	void drawCamCoord();
+	void drawVoxels(FrameSnapshot const&);
 
 public:
 	int NumFrames;
@@ -71,6 +85,24 @@ private:
 	// camera and corner coordinates 
 	std::vector<std::vector<cv::Point3f>> camCorners;
 
+	// corners of the acquisition space
+	std::vector<cv::Point3f> volumeCorners;
+
 	// edge points of the virtual ground floor grid
 	std::vector<std::vector<cv::Point3f>> gridEdges;
+
+	// vertex buffers (0 when vertex buffer objects are unavailable, the vertex arrays are then drawn from memory)
+	bool buffersReady;
+	bool staticDirty;
+	GLuint staticBuffer;
+	GLuint voxelBuffer;
+	size_t voxelCapacity;
+	int voxelFrame;			// frame index of the voxels in the voxel buffer
+
+	std::vector<ColorVertex> staticVertices;
+
+	VertexRange camCoordRange;
+	VertexRange gridRange;
+	VertexRange volumeRange;
+	VertexRange originRange;
 };
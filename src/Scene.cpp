@@ -0,0 +1,71 @@
+#include "Scene.hpp"
+
+#include <iostream>
+#include <filesystem>
+
+#include <opencv2/opencv.hpp>
+
+#include "Main.hpp"
+
+// The default scene is the recorded data set in the data/ directory. Its fourth view
+// is so noisy that it is left out when intersecting the tracking lines.
+Scene::Scene() :
+Width(ViewWidth), Height(ViewHeight), NumFrames(0), IgnoredView(3), Fps(25.0) {
+	static const char* names[] = { "f", "l", "r", "s" };
+
+	for (int i = 0; i < NumViews; ++i) {
+		std::string name = names[i];
+		Views.push_back({
+			name,
+			"data/camparam_" + name + ".ini",
+			"data/background_" + name + ".bmp",
+			"data/video_" + name + ".avi"
+		});
+	}
+
+	Persons.push_back("data/init-person1.jpg");
+	Persons.push_back("data/init-person2.jpg");
+}
+
+// Loads a scene description. Paths in the description are relative to its directory.
+bool Scene::Load(std::string const& path) {
+	cv::FileStorage file(path, cv::FileStorage::READ);
+	if (!file.isOpened()) {
+		std::cerr << "Unable to open scene " << path << std::endl;
+		return false;
+	}
+
+	std::filesystem::path dir = std::filesystem::path(path).parent_path();
+	auto resolve = [&dir](std::string const& p) {
+		return p.empty() ? p : (dir / p).string();
+	};
+
+	Width = static_cast<int>(file["width"]);
+	Height = static_cast<int>(file["height"]);
+	NumFrames = static_cast<int>(file["frames"]);
+	Fps = static_cast<double>(file["fps"]);
+	IgnoredView = file["ignored_view"].empty() ? -1 : static_cast<int>(file["ignored_view"]);
+
+	Views.clear();
+	for (cv::FileNode const& node : file["views"]) {
+		Views.push_back({
+			static_cast<std::string>(node["name"]),
+			resolve(node["calibration"]),
+			resolve(node["background"]),
+			resolve(node["video"])
+		});
+	}
+
+	Persons.clear();
+	for (cv::FileNode const& node : file["persons"]) {
+		Persons.push_back(resolve(node));
+	}
+
+	GroundTruth = resolve(file["groundtruth"]);
+
+	if (Views.empty() || Persons.size() < 2 || Width <= 0 || Height <= 0) {
+		std::cerr << "Scene " << path << " is incomplete" << std::endl;
+		return false;
+	}
+	return true;
+}
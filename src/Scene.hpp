@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Input files of a single camera view.
+struct ViewSource {
+	std::string name;
+	std::string calibration;
+	std::string background;
+	std::string video;
+};
+
+// Description of a multi-view data set: the views, the initial person images and (optionally) ground truth.
+class Scene {
+public:
+	Scene();
+
+public:
+	bool Load(std::string const&);	// scene description as written by the scene generator
+
+public:
+	int Width;
+	int Height;
+	int NumFrames;					// number of frames in the sequence (0 if unknown)
+	int IgnoredView;				// view that is too noisy for tracking (-1 if none)
+	double Fps;
+
+	std::vector<ViewSource> Views;
+	std::vector<std::string> Persons;	// initial person images
+	std::string GroundTruth;			// ground truth positions (empty if unavailable)
+};
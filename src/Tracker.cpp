@@ -1,5 +1,8 @@
 #include "Tracker.hpp"
 
+#include <cmath>
+#include <algorithm>
+
 #include <GL/freeglut.h>
 
 #include "Main.hpp"
@@ -9,22 +12,65 @@
 #include "Constants.hpp"
 #include "VoxelGrid.hpp"
 
-Tracker::Tracker(cv::Mat const fgA, cv::Mat const fgB, std::vector<std::shared_ptr<Camera>> const cams) : cameras(cams) {
+// size of the box around a person that is searched for in the views, in millimeters
+static const float PersonRadius = 500.f;
+static const float PersonHeight = 2000.f;
+
+Tracker::Tracker(cv::Mat const fgA, cv::Mat const fgB, std::vector<std::shared_ptr<Camera>> const cams) : 
+cameras(cams), IgnoredView(-1), UseSearchRegions(true) {
+	imageHistA.resize(cameras.size());
+	imageHistB.resize(cameras.size());
+	linePosWorldA.resize(cameras.size());
+	linePosWorldB.resize(cameras.size());
+	MissingViews.assign(cameras.size(), false);
+
 	colorHistA.CreateColorHistogram(fgA);
 	colorHistB.CreateColorHistogram(fgB);
 }
 
 // Retrieves the foreground image based on a frame image and a mask.
 cv::Mat Tracker::ExtractForeground(cv::Mat frame, cv::Mat mask) const {
-	cv::Mat fg = cv::Mat(frame.size(), frame.depth(), frame.channels());
+	cv::Mat fg = cv::Mat::zeros(frame.size(), frame.type());
 	frame.copyTo(fg, mask);
 	return fg;
 }
 
+// Image columns covered by a person standing at the given position, widened by the given margin.
+cv::Range Tracker::searchColumns(int view, cv::Point2f position, float margin, int width) const {
+	const float radius = PersonRadius + margin;
+
+	float minX = castf(width);
+	float maxX = 0.f;
+	for (int corner = 0; corner < 8; ++corner) {
+		cv::Point3f p(
+			position.x + ((corner & 1) ? radius : -radius),
+			position.y + ((corner & 2) ? radius : -radius),
+			(corner & 4) ? PersonHeight : 0.f);
+		cv::Point2f pixel = cameras[view]->Project(p);
+		minX = std::min(minX, pixel.x);
+		maxX = std::max(maxX, pixel.x);
+	}
+
+	int start = std::max(0, casti(std::floor(minX)));
+	int end = std::min(width, casti(std::ceil(maxX)) + 1);
+	if (!std::isfinite(minX) || !std::isfinite(maxX) || start >= end) {
+		return cv::Range(0, width);
+	}
+	return cv::Range(start, end);
+}
+
 void Tracker::TrackPersons(std::vector<cv::Mat> foregrounds, int views) {
 	// back-projected lines
 	std::vector<Line2f> linesA;
 	std::vector<Line2f> linesB;
+
+	// predicted positions of both persons, the search regions grow with their uncertainty
+	bool predictA = UseSearchRegions && motionA.IsInitialized();
+	bool predictB = UseSearchRegions && motionB.IsInitialized();
+	cv::Point2f predictedA = motionA.IsInitialized() ? motionA.Predict() : cv::Point2f();
+	cv::Point2f predictedB = motionB.IsInitialized() ? motionB.Predict() : cv::Point2f();
+	float marginA = 3.f * motionA.Uncertainty();
+	float marginB = 3.f * motionB.Uncertainty();
 	
 	// iterate over views
 	for (int v = 0; v < views; ++v) {
@@ -32,18 +78,31 @@ void Tracker::TrackPersons(std::vector<cv::Mat> foregrounds, int views) {
 		imageHistA[v].Reset();
 		imageHistB[v].Reset();
 
+		if (MissingViews[v]) {
+			continue;
+		}
+
 		// acquire foreground of the current view
 		cv::Mat foreground = foregrounds[v];
 
 		int imgwidth = foreground.size().width;
 		int imgheight = foreground.size().height;
 
+		// columns to search for each person
+		cv::Range columnsA = predictA ? searchColumns(v, predictedA, marginA, imgwidth) : cv::Range(0, imgwidth);
+		cv::Range columnsB = predictB ? searchColumns(v, predictedB, marginB, imgwidth) : cv::Range(0, imgwidth);
+
 		// Iterate over foreground pixels with respect to the x-axis of the image (columns, then rows).
-		for (int x = 0; x < imgwidth; ++x) {
+		for (int x = std::min(columnsA.start, columnsB.start); x < std::max(columnsA.end, columnsB.end); ++x) {
+			bool inA = x >= columnsA.start && x < columnsA.end;
+			bool inB = x >= columnsB.start && x < columnsB.end;
+			if (!inA && !inB) {
+				continue;
+			}
+
 			for (int y = 0; y < imgheight; ++y) {
 				// retrieve color of this pixel
-				//cv::Scalar pixelColor = cvGet2D(foreground, y, x);
-				cv::Scalar pixelColor = foreground.at<cv::Scalar>(y, x);
+				cv::Vec3b pixelColor = foreground.at<cv::Vec3b>(y, x);
 
 				// ignore very dark pixels
 				if (pixelColor.val[0] < 5 && pixelColor.val[1] < 5 && pixelColor.val[2] < 5) {
@@ -55,14 +114,13 @@ void Tracker::TrackPersons(std::vector<cv::Mat> foregrounds, int views) {
 					continue;
 				}
 
-				// determine the color and image bins
-				int colorBin = static_cast<int>(COLOR_DEPTH / NUM_BINS);
+				// determine the image bin
 				int imageBin = static_cast<int>(floorf((static_cast<float>(NUM_BINS) / imgwidth) * x));
 				
-				// find the appropriate bins for this pixel
-				uint8_t indexR = static_cast<uint8_t>(std::floor(pixelColor.val[0] / colorBin));
-				uint8_t indexG = static_cast<uint8_t>(std::floor(pixelColor.val[1] / colorBin));
-				uint8_t indexB = static_cast<uint8_t>(std::floor(pixelColor.val[2] / colorBin));
+				// find the appropriate color bins for this pixel
+				int indexR = Histogram::ColorBin(pixelColor.val[0]);
+				int indexG = Histogram::ColorBin(pixelColor.val[1]);
+				int indexB = Histogram::ColorBin(pixelColor.val[2]);
 
 				// find occurrences of the color values in both color histograms
 				float valueR[2] = { colorHistA.R(indexR), colorHistB.R(indexR) };
@@ -70,8 +128,12 @@ void Tracker::TrackPersons(std::vector<cv::Mat> foregrounds, int views) {
 				float valueB[2] = { colorHistA.B(indexB), colorHistB.B(indexB) };
 				
 				// fill image histograms based on the occurrences of pixel color values
-				imageHistA[v].AddValues(imageBin, valueR[0], valueG[0], valueB[0]);
-				imageHistB[v].AddValues(imageBin, valueR[1], valueG[1], valueB[1]);
+				if (inA) {
+					imageHistA[v].AddValues(imageBin, valueR[0], valueG[0], valueB[0]);
+				}
+				if (inB) {
+					imageHistB[v].AddValues(imageBin, valueR[1], valueG[1], valueB[1]);
+				}
 			}
 		}
 		
@@ -86,26 +148,47 @@ void Tracker::TrackPersons(std::vector<cv::Mat> foregrounds, int views) {
 		// label the persons in the foreground
 		LabelForeground(linePosHistA, linePosHistB, foreground);
 
-		// scale the x-coordinate by the ratio of the scene screen size to the size of the histogram
-		linePosHistA.x *= SCREEN_WIDTH / NUM_BINS;
-		linePosHistB.x *= SCREEN_WIDTH / NUM_BINS;
+		// scale the x-coordinate by the ratio of the view width to the size of the histogram
+		linePosHistA.x *= imgwidth / NUM_BINS;
+		linePosHistB.x *= imgwidth / NUM_BINS;
 		
 		// back-project these 2D positions into 3D space
-		linePosWorldA[v] = cameras[v]->Point2DtoWorld3D(linePosHistA);
-		linePosWorldB[v] = cameras[v]->Point2DtoWorld3D(linePosHistB);
-
-		// construct line equation from the camera location to the person's pixel position in 3D
-		linesA[v] = Line2f::Line2DFrom3D(cameras[v]->PosWorld, linePosWorldA[v]);
-		linesB[v] = Line2f::Line2DFrom3D(cameras[v]->PosWorld, linePosWorldB[v]);
+		cv::Point linePos[2] = { linePosHistA, linePosHistB };
+		cv::Point3f linePosWorld[2];
+		cameras[v]->Point2DtoWorld3D(linePos, linePosWorld, 2);
+		linePosWorldA[v] = linePosWorld[0];
+		linePosWorldB[v] = linePosWorld[1];
+
+		// construct line equation from the camera location to the person's pixel position in 3D,
+		// unless the peak lies outside the search region (nothing of the person was found there)
+		int binWidth = imgwidth / NUM_BINS;
+		if (v != IgnoredView) {
+			if (linePosHistA.x + binWidth > columnsA.start && linePosHistA.x < columnsA.end) {
+				linesA.push_back(Line2f::Line2DFrom3D(cameras[v]->PosWorld, linePosWorldA[v]));
+			}
+			if (linePosHistB.x + binWidth > columnsB.start && linePosHistB.x < columnsB.end) {
+				linesB.push_back(Line2f::Line2DFrom3D(cameras[v]->PosWorld, linePosWorldB[v]));
+			}
+		}
 	}
 	
 	// find mean intersection of the lines to retrieve the persons' positions on the plane
-	cv::Point2f meanPlanePosA = Line2f::FindMeanIntersection(&linesA[0]);
-	cv::Point2f meanPlanePosB = Line2f::FindMeanIntersection(&linesB[0]);
+	cv::Point2f meanPlanePosA = Line2f::FindMeanIntersection(linesA);
+	cv::Point2f meanPlanePosB = Line2f::FindMeanIntersection(linesB);
+
+	// filter the measured positions, a person without a measurement (less than two lines) keeps the predicted position
+	cv::Point2f planePosA = predictedA;
+	cv::Point2f planePosB = predictedB;
+	if (linesA.size() >= 2 && std::isfinite(meanPlanePosA.x) && std::isfinite(meanPlanePosA.y)) {
+		planePosA = motionA.Correct(meanPlanePosA);
+	}
+	if (linesB.size() >= 2 && std::isfinite(meanPlanePosB.x) && std::isfinite(meanPlanePosB.y)) {
+		planePosB = motionB.Correct(meanPlanePosB);
+	}
 
 	// define the final person locations in 3D space
-	PersonPosA = cv::Point3f(meanPlanePosA.x, meanPlanePosA.y, 0.0);
-	PersonPosB = cv::Point3f(meanPlanePosB.x, meanPlanePosB.y, 0.0);
+	PersonPosA = cv::Point3f(planePosA.x, planePosA.y, 0.0);
+	PersonPosB = cv::Point3f(planePosB.x, planePosB.y, 0.0);
 }
 
 // Indicates both persons with a colored line in the foreground image.
@@ -130,7 +213,7 @@ void Tracker::LabelVoxels(std::shared_ptr<VoxelGrid> vr, cv::Point3f center, flo
 
 	// only label visible voxels
 	for (unsigned i = 0; i < vr->visibleVoxels.size(); ++i) {
-		Voxel voxel = vr->visibleVoxels[i];
+		Voxel& voxel = vr->visibleVoxels[i];
 
 		// check if this voxel is within the bounding box
 		if (voxel.x > xstart && voxel.x < xend) {
@@ -152,19 +235,19 @@ void Tracker::LabelVoxels(std::shared_ptr<VoxelGrid> vr, cv::Point3f center, flo
 }
 
 // Draws lines for both persons
-void Tracker::LabelLines() {
-	DrawLabelLines(linePosWorldA, CV_RGB(0, 200, 0), 8000.f);
-	DrawLabelLines(linePosWorldB, CV_RGB(0, 0, 200), 8000.f);
+void Tracker::LabelLines(std::vector<cv::Point3f> const& positionsA, std::vector<cv::Point3f> const& positionsB) const {
+	DrawLabelLines(positionsA, CV_RGB(0, 200, 0), 8000.f);
+	DrawLabelLines(positionsB, CV_RGB(0, 0, 200), 8000.f);
 }
 
 // Draws grids for both persons
-void Tracker::LabelGrids() {
-	DrawLabelGrids(PersonPosA, 350.f, 750.f, 2000.0f, CV_RGB(0, 200, 0));
-	DrawLabelGrids(PersonPosB, 350.f, 750.f, 2000.0f, CV_RGB(0, 0, 200));
+void Tracker::LabelGrids(cv::Point3f personA, cv::Point3f personB) const {
+	DrawLabelGrids(personA, 350.f, 750.f, 2000.0f, CV_RGB(0, 200, 0));
+	DrawLabelGrids(personB, 350.f, 750.f, 2000.0f, CV_RGB(0, 0, 200));
 }
 
 // Draws lines from the origin of each camera towards the person in the scene with the given color and length
-void Tracker::DrawLabelLines(cv::Point3f* positions, cv::Scalar color, float length) const {
+void Tracker::DrawLabelLines(std::vector<cv::Point3f> const& positions, cv::Scalar color, float length) const {
 	glPushMatrix();
 	
 	glColor4d(color.val[2] / 256.0, color.val[1] / 256.0, color.val[0] / 256.0, 1.0);
@@ -172,7 +255,8 @@ void Tracker::DrawLabelLines(cv::Point3f* positions, cv::Scalar color, float len
 	
 	glBegin(GL_LINES);
 
-	for (int v = 0; v < 4; ++v) {
+	int views = static_cast<int>(std::min(cameras.size(), positions.size()));
+	for (int v = 0; v < views; ++v) {
 		// need camera and pixel positions on the plane
 		cv::Point3f cameraOrigin = cv::Point3f(cameras[v]->PosWorld.x, cameras[v]->PosWorld.y, 0);
 		cv::Point3f linePosWorld = positions[v];
@@ -6,6 +6,7 @@
 #include <opencv2/opencv.hpp>
 
 #include "Histogram.hpp"
+#include "MotionModel.hpp"
 
 class Camera;
 class VoxelGrid;
@@ -17,20 +18,33 @@ private:
 	Histogram colorHistB;
 	
 	// image histograms for both persons, for each view
-	Histogram imageHistA[4];
-	Histogram imageHistB[4];
+	std::vector<Histogram> imageHistA;
+	std::vector<Histogram> imageHistB;
 
 	// back-projected positions of person's pixel position
-	cv::Point3f linePosWorldA[4];
-	cv::Point3f linePosWorldB[4];
+	std::vector<cv::Point3f> linePosWorldA;
+	std::vector<cv::Point3f> linePosWorldB;
 
 	// local storage of the cameras
 	std::vector<std::shared_ptr<Camera>> const cameras;
 
+	// motion of both persons on the ground plane
+	MotionModel motionA;
+	MotionModel motionB;
+
 public: // variables
 	// final location of person (at intersection of lines)
 	cv::Point3f PersonPosA;
 	cv::Point3f PersonPosB;
+
+	// view that is left out of the line intersections (-1 to use all views)
+	int IgnoredView;
+
+	// views without a current frame, they are not searched at all
+	std::vector<bool> MissingViews;
+
+	// only search the image columns around the predicted position of each person
+	bool UseSearchRegions;
 	
 public: // constructor
 	Tracker(cv::Mat const, cv::Mat const, std::vector<std::shared_ptr<Camera>> const);
@@ -42,17 +56,29 @@ public: // functions
 	void LabelForeground(cv::Point posA, cv::Point posB, cv::Mat foreground) const;
 	void LabelVoxels(std::shared_ptr<VoxelGrid> vr, cv::Point3f center, float sizeX, float sizeY, cv::Scalar color) const;
 	
-	void LabelLines();
-	void LabelGrids();
+	void LabelLines(std::vector<cv::Point3f> const& positionsA, std::vector<cv::Point3f> const& positionsB) const;
+	void LabelGrids(cv::Point3f personA, cv::Point3f personB) const;
 	
-	void DrawLabelLines(cv::Point3f* positions, cv::Scalar color, float length) const;
+	void DrawLabelLines(std::vector<cv::Point3f> const& positions, cv::Scalar color, float length) const;
 	void DrawLabelGrids(cv::Point3f personLocation, float sizeX, float sizeY, float height, cv::Scalar color) const;
 
-	inline Histogram GetImageHistogramA(int view) {
+private:
+	cv::Range searchColumns(int view, cv::Point2f position, float margin, int width) const;
+
+public:
+	inline Histogram const& GetImageHistogramA(int view) const {
 		return imageHistA[view];
 	}
 
-	inline Histogram GetImageHistogramB(int view) {
+	inline Histogram const& GetImageHistogramB(int view) const {
 		return imageHistB[view];
 	}
+
+	inline std::vector<cv::Point3f> const& GetLinePosWorldA() const {
+		return linePosWorldA;
+	}
+
+	inline std::vector<cv::Point3f> const& GetLinePosWorldB() const {
+		return linePosWorldB;
+	}
 };
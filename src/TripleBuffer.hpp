@@ -0,0 +1,49 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Lock-free hand-over of values from one writer thread to one reader thread. The writer fills
+// the back buffer and publishes it; the reader always picks up the latest published value.
+// Neither side ever waits for the other, values that are not picked up in time are dropped.
+template <typename T>
+class TripleBuffer {
+public:
+	TripleBuffer() : back(0), front(2), middle(1) {}
+
+public: // writer
+	T& Back() {
+		return buffers[back];
+	}
+
+	void Publish() {
+		uint8_t previous = middle.exchange(static_cast<uint8_t>(back | DirtyBit), std::memory_order_acq_rel);
+		back = previous & IndexMask;
+	}
+
+public: // reader
+	// Takes the latest published value as the front buffer; returns false if nothing new was published.
+	bool Update() {
+		if (!(middle.load(std::memory_order_relaxed) & DirtyBit)) {
+			return false;
+		}
+		uint8_t previous = middle.exchange(static_cast<uint8_t>(front), std::memory_order_acq_rel);
+		front = previous & IndexMask;
+		return true;
+	}
+
+	T const& Front() const {
+		return buffers[front];
+	}
+
+private:
+	static const uint8_t IndexMask = 0x3;
+	static const uint8_t DirtyBit = 0x4;
+
+	std::array<T, 3> buffers;
+
+	uint8_t back;					// owned by the writer
+	uint8_t front;					// owned by the reader
+	std::atomic<uint8_t> middle;	// index of the buffer in between, plus the dirty bit
+};
@@ -0,0 +1,114 @@
+#include "VoxelClusters.hpp"
+
+#include <climits>
+#include <algorithm>
+
+#include <opencv2/opencv.hpp>
+
+#include "Main.hpp"
+#include "VoxelGrid.hpp"
+
+// a person carved from 50 mm voxels covers a few thousand voxels, the noise only a handful
+static const int DefaultMinVoxels = 100;
+
+VoxelClusters::VoxelClusters() : MinVoxels(DefaultMinVoxels) {
+}
+
+void VoxelClusters::Update(VoxelGrid const& grid) {
+	Clusters.clear();
+
+	if (casti(labels.size()) != grid.numVoxels) {
+		labels.assign(grid.numVoxels, 0);
+	}
+
+	// mark the occupied voxels
+	for (int v : grid.visibleIndices) {
+		labels[v] = -1;
+	}
+
+	const int strideY = grid.numZ;
+	const int strideX = grid.numY * grid.numZ;
+
+	int component = 0;
+	for (int seed : grid.visibleIndices) {
+		if (labels[seed] != -1) {
+			continue;
+		}
+
+		// breadth-first flood fill, the queue doubles as the list of voxels in the component
+		component++;
+		labels[seed] = component;
+		queue.clear();
+		queue.push_back(seed);
+
+		for (size_t head = 0; head < queue.size(); ++head) {
+			int v = queue[head];
+			int ix = v / strideX;
+			int iy = (v / strideY) % grid.numY;
+			int iz = v % grid.numZ;
+
+			for (int dx = -1; dx <= 1; ++dx) {
+				if (ix + dx < 0 || ix + dx >= grid.numX) {
+					continue;
+				}
+				for (int dy = -1; dy <= 1; ++dy) {
+					if (iy + dy < 0 || iy + dy >= grid.numY) {
+						continue;
+					}
+					for (int dz = -1; dz <= 1; ++dz) {
+						if (iz + dz < 0 || iz + dz >= grid.numZ) {
+							continue;
+						}
+
+						int n = v + dx * strideX + dy * strideY + dz;
+						if (labels[n] == -1) {
+							labels[n] = component;
+							queue.push_back(n);
+						}
+					}
+				}
+			}
+		}
+
+		if (casti(queue.size()) < MinVoxels) {
+			continue;
+		}
+
+		// statistics of the component
+		VoxelCluster cluster;
+		cluster.Count = casti(queue.size());
+		cluster.Min = cv::Point3i(INT_MAX, INT_MAX, INT_MAX);
+		cluster.Max = cv::Point3i(INT_MIN, INT_MIN, INT_MIN);
+
+		double sumX = 0.0;
+		double sumY = 0.0;
+		double sumZ = 0.0;
+		for (int v : queue) {
+			Voxel const& voxel = grid.voxels[v];
+			sumX += voxel.x;
+			sumY += voxel.y;
+			sumZ += voxel.z;
+			cluster.Min.x = std::min(cluster.Min.x, voxel.x);
+			cluster.Min.y = std::min(cluster.Min.y, voxel.y);
+			cluster.Min.z = std::min(cluster.Min.z, voxel.z);
+			cluster.Max.x = std::max(cluster.Max.x, voxel.x + grid.voxelSize);
+			cluster.Max.y = std::max(cluster.Max.y, voxel.y + grid.voxelSize);
+			cluster.Max.z = std::max(cluster.Max.z, voxel.z + grid.voxelSize);
+		}
+		cluster.Centroid = cv::Point3f(
+			castf(sumX / cluster.Count),
+			castf(sumY / cluster.Count),
+			castf(sumZ / cluster.Count));
+
+		Clusters.push_back(cluster);
+	}
+
+	// leave the labels empty for the next update
+	for (int v : grid.visibleIndices) {
+		labels[v] = 0;
+	}
+
+	std::sort(Clusters.begin(), Clusters.end(), [](VoxelCluster const& a, VoxelCluster const& b) {
+		return a.Count > b.Count;
+	});
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+class VoxelGrid;
+
+// Connected group of occupied voxels.
+struct VoxelCluster {
+	cv::Point3f Centroid;	// mean position of the voxels in millimeters
+	cv::Point3i Min;		// bounding box in millimeters, from the lowest voxel corner
+	cv::Point3i Max;		// to the highest voxel corner
+	int Count = 0;			// number of voxels
+};
+
+// Groups the occupied voxels of a grid into 26-connected components. Runs in time linear in the
+// number of occupied voxels: neighbours are found through the grid's implicit indexing.
+class VoxelClusters {
+public:
+	VoxelClusters();
+
+public:
+	void Update(VoxelGrid const&);
+
+public:
+	int MinVoxels;							// smaller components are dropped as noise
+	std::vector<VoxelCluster> Clusters;		// components of the last update, largest first
+
+private:
+	std::vector<int> labels;	// per voxel: 0 empty, -1 occupied, otherwise the component number
+	std::vector<int> queue;
+};
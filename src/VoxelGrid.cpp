@@ -2,6 +2,7 @@
 
 #include <vector>
 #include <iostream>
+#include <algorithm>
 
 #include <opencv2/opencv.hpp>
 
@@ -13,10 +14,9 @@ const int VoxelGrid::GridNum = 4;
 const int VoxelGrid::GridSize = 400;
 const int VoxelGrid::VoxelStep = 50;
 
-VoxelGrid::VoxelGrid(int w, int h, std::vector<std::shared_ptr<Camera>> cameras) : 
-numViews(casti(cameras.size())), viewWidth(w), viewHeight(h) {
+VoxelGrid::VoxelGrid(int w, int h, std::vector<std::shared_ptr<Camera>> cameras, bool depthOrder) : 
+numViews(casti(cameras.size())), viewWidth(w), viewHeight(h), depthOrdered(depthOrder) {
 	// Create Look Up Table for each view
-	LUT = std::vector<std::shared_ptr<LookupTable>>(numViews, nullptr);
 	for (int i = 0; i < numViews; i ++) {
 		LUT.push_back(std::make_shared<LookupTable>(viewWidth, viewHeight));
 	}
@@ -46,48 +46,137 @@ numViews(casti(cameras.size())), viewWidth(w), viewHeight(h) {
 	volumeCorners[6] = cv::Point3f(castf(xR), castf(yR), castf(zR));
 	volumeCorners[7] = cv::Point3f(castf(xR), castf(yL), castf(zR));
 
-	numVoxels = (edge / VoxelStep) * (edge / VoxelStep) * ((edge - (halfEdge / 2)) / VoxelStep);
+	voxelSize = VoxelStep;
+	numX = edge / VoxelStep;
+	numY = edge / VoxelStep;
+	numZ = (zR - zL + VoxelStep - 1) / VoxelStep;
+	numVoxels = numX * numY * numZ;
+
+	groundOccupancy = cv::Mat::zeros(numX, numY, CV_16U);
+	groundHeight = cv::Mat::zeros(numX, numY, CV_16U);
 
 	// the whole voxel list
 	voxels.resize(numVoxels);
+	colorOffsets.assign(static_cast<size_t>(numVoxels) * numViews, -1);
+	visibleSlots.assign(numVoxels, -1);
+	for (int i = 0; i < numViews; i ++) {
+		viewPositions.push_back(cameras[i]->PosWorld);
+	}
+
+	// the surface of each view is kept as one bit per view
+	if (depthOrdered && numViews > 32) {
+		std::cerr << "Depth ordering supports at most 32 views" << std::endl;
+		depthOrdered = false;
+	}
 
 	int percentSign = 10;
-	std::cout << "Number of voxels " << numVoxels << std::endl;
-	std::cout << "Now initializing look-up table ";
+	std::cerr << "Number of voxels " << numVoxels << std::endl;
+	std::cerr << "Now initializing look-up table ";
+
+	// one column of voxels is projected at a time
+	std::vector<cv::Point3f> column;
+	std::vector<cv::Point2f> pixels((zR - zL + VoxelStep - 1) / VoxelStep);
+	std::vector<cv::Point2f> framePixels(pixels.size());
+	std::vector<float> viewDistances(pixels.size());
 
 	// voxel index
 	int v = 0;
 	for (int x = xL; x < xR; x += VoxelStep) {
 		for (int y = yL; y < yR; y += VoxelStep) {
+			column.clear();
 			for (int z = zL; z < zR; z += VoxelStep) {
 				// initialize the voxels
-				voxels[v].x = x;
-				voxels[v].y = y;
-				voxels[v].z = z;
-				voxels[v].numVisible = 0;
-				voxels[v].view = numViews;
-
-				// project 3D voxel to each 2D view
-				// attach to the corresponding pixel's LookupTable
-				for (int i = 0; i < numViews; i ++) {
-					cv::Point pt = cameras[i]->ProjectOnView(
-						cv::Point3f(castf(x), castf(y), castf(z)));
+				Voxel& voxel = voxels[v + casti(column.size())];
+				voxel.x = x;
+				voxel.y = y;
+				voxel.z = z;
+				voxel.numVisible = 0;
+				voxel.view = numViews;
+				column.push_back(cv::Point3f(castf(x), castf(y), castf(z)));
+			}
+
+			// project 3D voxels to each 2D view
+			// attach to the corresponding pixel's LookupTable
+			for (int i = 0; i < numViews; i ++) {
+				cameras[i]->Project(column.data(), pixels.data(), casti(column.size()), !cameras[i]->UndistortForeground);
+
+				// colors are sampled from the frames, which are never undistorted
+				if (cameras[i]->UndistortForeground) {
+					cameras[i]->Project(column.data(), framePixels.data(), casti(column.size()), true);
+				}
+				else {
+					std::copy(pixels.begin(), pixels.begin() + column.size(), framePixels.begin());
+				}
+
+				for (int c = 0; c < casti(column.size()); c ++) {
+					cv::Point pt(casti(pixels[c].x), casti(pixels[c].y));
 					// if the voxel is visible in current view, save its idex to the LookupTable of the pixel it projects on
 					if ((pt.x >= 0) && (pt.x < viewWidth) && (pt.y >= 0) && (pt.y < viewHeight)) {
-						//	std::cout << v << " " << pt.x << " " << pt.y << std::endl;
-						LUT[i]->lut[pt.x][pt.y].push_back(v);
+						LUT[i]->lut[pt.x][pt.y].push_back(v + c);
+					}
+
+					// the pixel that provides the voxel's color in this view
+					cv::Point fp(casti(framePixels[c].x), casti(framePixels[c].y));
+					if ((fp.x < 0) || (fp.x >= viewWidth) || (fp.y < 0) || (fp.y >= viewHeight)) {
+						continue;
+					}
+					colorOffsets[static_cast<size_t>(v + c) * numViews + i] = 3 * (fp.y * viewWidth + fp.x);
+
+					// the nearest view that sees the voxel
+					float distance = castf(cv::norm(column[c] - cameras[i]->PosWorld));
+					if (voxels[v + c].view == numViews || distance < viewDistances[c]) {
+						voxels[v + c].view = i;
+						viewDistances[c] = distance;
 					}
 				}
-				v ++;
-				if ((numVoxels / v) == percentSign) {
-					std::cout << ".";
-					percentSign--;
+			}
+
+			v += casti(column.size());
+			if ((numVoxels / v) <= percentSign) {
+				std::cerr << ".";
+				percentSign--;
+			}
+		}
+	}
+
+	std::cerr << " Done." << std::endl;
+
+	// pixels without voxels cannot contribute to the carving
+	tableSpans.assign(numViews, std::vector<cv::Range>(viewHeight, cv::Range(0, 0)));
+	for (int i = 0; i < numViews; i ++) {
+		for (int x = 0; x < viewWidth; x ++) {
+			for (int y = 0; y < viewHeight; y ++) {
+				if (LUT[i]->lut[x][y].empty()) {
+					continue;
 				}
+
+				cv::Range& span = tableSpans[i][y];
+				span = span.empty() ? cv::Range(x, x + 1) : cv::Range(span.start, x + 1);
 			}
 		}
 	}
 
-	std::cout << " Done." << std::endl;
+	// sort the voxels of each pixel by their distance to the camera, nearest first
+	if (depthOrdered) {
+		for (int i = 0; i < numViews; i ++) {
+			cv::Point3f const& camera = viewPositions[i];
+			auto distanceSq = [&](int index) {
+				Voxel const& voxel = voxels[index];
+				float dx = castf(voxel.x) - camera.x;
+				float dy = castf(voxel.y) - camera.y;
+				float dz = castf(voxel.z) - camera.z;
+				return dx * dx + dy * dy + dz * dz;
+			};
+
+			for (auto& column : LUT[i]->lut) {
+				for (auto& entries : column) {
+					std::sort(entries.begin(), entries.end(), [&](int a, int b) {
+						return distanceSq(a) < distanceSq(b);
+					});
+				}
+			}
+		}
+	}
 }
 
 void VoxelGrid::UpdateVoxels(std::vector<std::shared_ptr<Camera>> cameras) {
@@ -97,14 +186,16 @@ void VoxelGrid::UpdateVoxels(std::vector<std::shared_ptr<Camera>> cameras) {
 		}
 	}
 
-	visibleVoxels.clear();
+	clearVisible();
 
-	// update the voxel list
+	// update the voxel list, only the pixels that have voxels are visited
 	for (int i = 0; i < numViews; i ++) {
-		for (int x = 0; x < viewWidth; x ++) {
-			for (int y = 0; y < viewHeight; y ++) {
+		for (int y = 0; y < viewHeight; y ++) {
+			cv::Range const& span = tableSpans[i][y];
+			uint8_t const* mask = cameras[i]->Foreground.ptr<uint8_t>(y);
+			for (int x = span.start; x < span.end; x ++) {
 				// if it is a foreground pixel
-				if (cameras[i]->Foreground.at<uint8_t>(y, x) == 255) {
+				if (mask[x] == 255) {
 					// if some voxel is visible at this pixel
 					if (int(LUT[i]->lut[x][y].size()) > 0) {
 						int size = static_cast<int>(LUT[i]->lut[x][y].size());
@@ -118,7 +209,7 @@ void VoxelGrid::UpdateVoxels(std::vector<std::shared_ptr<Camera>> cameras) {
 
 								// if the voxel is visible in all views, marked it as visible voxel
 								if (voxels[v].numVisible == numViews) {
-									visibleVoxels.push_back(voxels[v]);
+									addVisible(v);
 								}
 							}
 						}
@@ -128,3 +219,146 @@ void VoxelGrid::UpdateVoxels(std::vector<std::shared_ptr<Camera>> cameras) {
 		}
 	}
 }
+
+void VoxelGrid::SetVisibleVoxels(std::vector<int> const& indices) {
+	for (int v : visibleIndices) {
+		voxels[v].numVisible = 0;
+	}
+
+	clearVisible();
+
+	for (int v : indices) {
+		if (v < 0 || v >= numVoxels) {
+			continue;
+		}
+
+		// grey (unlabeled) and visible in all views, as after carving
+		voxels[v].r = voxels[v].g = voxels[v].b = 150;
+		voxels[v].numVisible = numViews;
+		addVisible(v);
+	}
+}
+
+// Marks the visible voxels that are the first visible voxel along the ray of a foreground pixel.
+// The rays are walked front to back and stop at the first visible voxel, so the cost follows the
+// visible surface instead of the volume.
+void VoxelGrid::FindSurfaces(std::vector<std::shared_ptr<Camera>> const& cameras, std::vector<bool> const& missing) {
+	surfaceViews.assign(visibleIndices.size(), 0);
+	if (!depthOrdered) {
+		return;
+	}
+
+	uint32_t present = presentViews(missing);
+	for (int i = 0; i < numViews; i ++) {
+		if (!(present & (1u << i))) {
+			continue;
+		}
+
+		cv::Mat const& foreground = cameras[i]->Foreground;
+		for (int y = 0; y < viewHeight; y ++) {
+			cv::Range const& span = tableSpans[i][y];
+			uint8_t const* mask = foreground.ptr<uint8_t>(y);
+			for (int x = span.start; x < span.end; x ++) {
+				if (mask[x] != 255) {
+					continue;
+				}
+
+				for (int v : LUT[i]->lut[x][y]) {
+					if (visibleSlots[v] >= 0) {
+						surfaceViews[visibleSlots[v]] |= 1u << i;
+						break;
+					}
+				}
+			}
+		}
+	}
+}
+
+// Views that are not flagged as missing, as a bitmask.
+uint32_t VoxelGrid::presentViews(std::vector<bool> const& missing) const {
+	uint32_t present = 0;
+	for (int i = 0; i < numViews; i ++) {
+		if (i >= casti(missing.size()) || !missing[i]) {
+			present |= 1u << i;
+		}
+	}
+	return present;
+}
+
+// Looks up the color of each visible voxel. With depth ordering, the color comes from the nearest
+// view in which the voxel is on the surface, and occluded voxels are grey. Otherwise it comes from
+// the nearest view that sees the voxel. Missing views are skipped, the next nearest view is used.
+void VoxelGrid::SampleColors(std::vector<cv::Mat> const& frames, std::vector<bool> const& missing) {
+	int count = casti(visibleIndices.size());
+	visibleColors.resize(count);
+
+	// the frames are continuous, so a voxel's pixel is a fixed offset from the start of its frame
+	std::vector<uint8_t const*> data(numViews);
+	for (int i = 0; i < numViews; i ++) {
+		data[i] = frames[i].ptr<uint8_t>();
+	}
+
+	uint32_t present = presentViews(missing);
+	bool surfaces = depthOrdered && casti(surfaceViews.size()) == count;
+	int const* indices = visibleIndices.data();
+	cv::Vec3b* colors = visibleColors.data();
+	for (int i = 0; i < count; i ++) {
+		int v = indices[i];
+		int view = voxels[v].view;
+
+		// nearest view in which the voxel is not occluded, or nearest present view that sees it
+		// when its own nearest view is missing
+		if (surfaces || !(present & (1u << view))) {
+			view = numViews;
+			float nearest = 0.f;
+			for (int candidate = 0; candidate < numViews; candidate ++) {
+				bool usable = surfaces ? (surfaceViews[i] & (1u << candidate)) != 0 :
+					colorOffsets[static_cast<size_t>(v) * numViews + candidate] >= 0;
+				if (!usable || !(present & (1u << candidate))) {
+					continue;
+				}
+
+				cv::Point3f offset = cv::Point3f(castf(voxels[v].x), castf(voxels[v].y), castf(voxels[v].z)) - viewPositions[candidate];
+				float distance = offset.dot(offset);
+				if (view == numViews || distance < nearest) {
+					view = candidate;
+					nearest = distance;
+				}
+			}
+		}
+
+		int offset = (view < numViews) ? colorOffsets[static_cast<size_t>(v) * numViews + view] : -1;
+		if (offset >= 0) {
+			uint8_t const* pixel = data[view] + offset;
+			colors[i] = cv::Vec3b(pixel[0], pixel[1], pixel[2]);
+		}
+		else {
+			colors[i] = cv::Vec3b(150, 150, 150);
+		}
+	}
+}
+
+// Adds a voxel to the visible list and to the column above its ground cell.
+void VoxelGrid::addVisible(int v) {
+	Voxel const& voxel = voxels[v];
+	visibleSlots[v] = casti(visibleIndices.size());
+	visibleVoxels.push_back(voxel);
+	visibleIndices.push_back(v);
+
+	int column = v / numZ;
+	uint16_t& count = groundOccupancy.at<uint16_t>(column / numY, column % numY);
+	uint16_t& height = groundHeight.at<uint16_t>(column / numY, column % numY);
+	count++;
+	height = std::max(height, static_cast<uint16_t>(voxel.z + voxelSize));
+}
+
+void VoxelGrid::clearVisible() {
+	for (int v : visibleIndices) {
+		visibleSlots[v] = -1;
+	}
+
+	visibleVoxels.clear();
+	visibleIndices.clear();
+	groundOccupancy.setTo(0);
+	groundHeight.setTo(0);
+}
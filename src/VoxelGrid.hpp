@@ -17,17 +17,55 @@ private:
 	static const int VoxelStep;
 
 public:
-	VoxelGrid(int, int, std::vector<std::shared_ptr<Camera>>);
+	// with depth ordering, the look-up table entries of each pixel are sorted front to back
+	VoxelGrid(int, int, std::vector<std::shared_ptr<Camera>>, bool depthOrder = false);
 
 	void UpdateVoxels(std::vector<std::shared_ptr<Camera>>);
+	void SetVisibleVoxels(std::vector<int> const& indices);	// restores the visible voxels of a recorded frame
+	// views flagged as missing (without a current frame) are left out of both
+	void FindSurfaces(std::vector<std::shared_ptr<Camera>> const&, std::vector<bool> const& missing = {});	// visible voxels seen by each camera (needs depth ordering)
+	void SampleColors(std::vector<cv::Mat> const& frames, std::vector<bool> const& missing = {});	// colors of the visible voxels in the given (distorted) frames
 
 	int numViews;
 	int numVoxels;
 	int viewWidth;
 	int viewHeight;
 
+	// voxels along each axis, ordered by x, then y, then z (the z index changes fastest)
+	int numX;
+	int numY;
+	int numZ;
+	int voxelSize;
+
 	std::vector<Voxel> voxels;
 	std::vector<Voxel> visibleVoxels;
+	std::vector<int> visibleIndices;		// indices of the visible voxels in voxels
+	std::vector<cv::Vec3b> visibleColors;	// color of each visible voxel (BGR), see SampleColors
+
+	// per visible voxel, bit i is set when the voxel is the first visible one along a pixel ray
+	// of view i (it is not occluded in that view), see FindSurfaces
+	bool depthOrdered;
+	std::vector<uint32_t> surfaceViews;
+
+	// per voxel and view (voxel * numViews + view), the byte offset of its pixel in the frame of
+	// that view, -1 outside the frame
+	std::vector<int> colorOffsets;
+
+	// top-down view of the visible voxels, numX rows by numY columns, filled during carving
+	cv::Mat groundOccupancy;				// number of visible voxels above each cell (CV_16U)
+	cv::Mat groundHeight;					// top of the highest visible voxel above each cell in millimeters (CV_16U)
 	std::vector<cv::Point3f> volumeCorners; // 8 corners of the acquisition space
 	std::vector<std::shared_ptr<LookupTable>> LUT;
+
+private:
+	void addVisible(int v);
+	void clearVisible();
+	uint32_t presentViews(std::vector<bool> const& missing) const;
+
+private:
+	std::vector<cv::Point3f> viewPositions;	// camera positions in world coordinates
+	std::vector<int> visibleSlots;			// per voxel, its index in the visible list (-1 if not visible)
+
+	// per view and row, the columns whose pixels have voxels in the look-up table; carving skips the rest
+	std::vector<std::vector<cv::Range>> tableSpans;
 };
@@ -0,0 +1,123 @@
+#include "VoxelKMeans.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+#include <opencv2/opencv.hpp>
+
+#include "Main.hpp"
+#include "VoxelGrid.hpp"
+
+// the iterations stop once no center moves more than this, in millimeters
+static const float Convergence = 5.f;
+
+VoxelKMeans::VoxelKMeans() : MaxIterations(5), MaxDistance(1000.f), Iterations(0) {
+}
+
+void VoxelKMeans::Update(VoxelGrid const& grid, std::vector<cv::Point2f> const& seeds) {
+	int numTargets = casti(seeds.size());
+	int numVoxels = casti(grid.visibleVoxels.size());
+
+	// keep the centers of the last frame, start new or lost targets at their seeds
+	if (casti(Centers.size()) != numTargets) {
+		Centers = seeds;
+		Counts.assign(numTargets, 0);
+	}
+	for (int k = 0; k < numTargets; ++k) {
+		if (Counts[k] == 0) {
+			Centers[k] = seeds[k];
+		}
+	}
+
+	// centers inside the volume keep the squared distances within an int
+	float const minX = castf(grid.volumeCorners[0].x);
+	float const minY = castf(grid.volumeCorners[0].y);
+	float const maxX = castf(grid.volumeCorners[6].x);
+	float const maxY = castf(grid.volumeCorners[6].y);
+	for (cv::Point2f& center : Centers) {
+		center.x = std::isfinite(center.x) ? std::clamp(center.x, minX, maxX) : 0.f;
+		center.y = std::isfinite(center.y) ? std::clamp(center.y, minY, maxY) : 0.f;
+	}
+
+	xs.resize(numVoxels);
+	ys.resize(numVoxels);
+	nearest.resize(numVoxels);
+	Labels.resize(numVoxels);
+	for (int i = 0; i < numVoxels; ++i) {
+		xs[i] = grid.visibleVoxels[i].x;
+		ys[i] = grid.visibleVoxels[i].y;
+	}
+
+	int const maxDistanceSq = casti(MaxDistance * MaxDistance);
+	int const* x = xs.data();
+	int const* y = ys.data();
+	int* best = nearest.data();
+	int* label = Labels.data();
+
+	Iterations = 0;
+	while (Iterations < MaxIterations) {
+		Iterations++;
+
+		// assignment step, one pass over all voxels per center
+		for (int i = 0; i < numVoxels; ++i) {
+			best[i] = maxDistanceSq;
+			label[i] = -1;
+		}
+		for (int k = 0; k < numTargets; ++k) {
+			int const cx = casti(Centers[k].x);
+			int const cy = casti(Centers[k].y);
+			for (int i = 0; i < numVoxels; ++i) {
+				int dx = x[i] - cx;
+				int dy = y[i] - cy;
+				int d = dx * dx + dy * dy;
+				bool closer = d < best[i];
+				best[i] = closer ? d : best[i];
+				label[i] = closer ? k : label[i];
+			}
+		}
+
+		// update step, a target without voxels keeps its center
+		bool converged = true;
+		for (int k = 0; k < numTargets; ++k) {
+			int sumX = 0;
+			int sumY = 0;
+			int count = 0;
+			for (int i = 0; i < numVoxels; ++i) {
+				int member = -static_cast<int>(label[i] == k); // all bits set for the voxels of this target
+				sumX += x[i] & member;
+				sumY += y[i] & member;
+				count -= member;
+			}
+
+			Counts[k] = count;
+			if (count == 0) {
+				continue;
+			}
+
+			cv::Point2f center(castf(sumX) / castf(count), castf(sumY) / castf(count));
+			if (cv::norm(center - Centers[k]) > Convergence) {
+				converged = false;
+			}
+			Centers[k] = center;
+		}
+
+		if (converged) {
+			break;
+		}
+	}
+}
+
+void VoxelKMeans::Label(VoxelGrid& grid, std::vector<cv::Scalar> const& colors) const {
+	int numVoxels = std::min(casti(grid.visibleVoxels.size()), casti(Labels.size()));
+	for (int i = 0; i < numVoxels; ++i) {
+		int k = Labels[i];
+		if (k < 0 || k >= casti(colors.size())) {
+			continue;
+		}
+
+		Voxel& voxel = grid.visibleVoxels[i];
+		voxel.r = castf(colors[k].val[2]);
+		voxel.g = castf(colors[k].val[1]);
+		voxel.b = castf(colors[k].val[0]);
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+class VoxelGrid;
+
+// Assigns the visible voxels to a fixed number of targets with k-means on their ground plane
+// coordinates. The centers of the last frame seed the next one, so a few iterations suffice
+// and every target keeps its cluster from frame to frame.
+class VoxelKMeans {
+public:
+	VoxelKMeans();
+
+public:
+	// clusters the visible voxels, the seeds start the targets that have no center yet
+	void Update(VoxelGrid const&, std::vector<cv::Point2f> const& seeds);
+
+	// colors the visible voxels with the color of their target, unassigned voxels stay as they are
+	void Label(VoxelGrid&, std::vector<cv::Scalar> const& colors) const;
+
+public:
+	int MaxIterations;
+	float MaxDistance;		// voxels further than this from every center are not assigned, in millimeters
+
+	std::vector<cv::Point2f> Centers;	// per target
+	std::vector<int> Counts;			// number of voxels per target
+	std::vector<int> Labels;			// target of each visible voxel, -1 if none
+	int Iterations;						// iterations of the last update
+
+private:
+	// ground plane coordinates of the visible voxels, kept apart so the loops vectorize; integers
+	// (the voxel positions are whole millimeters) keep the sums vectorizable as well
+	std::vector<int> xs;
+	std::vector<int> ys;
+	std::vector<int> nearest;
+};
@@ -0,0 +1,409 @@
+/**
+ * 		End-to-end throughput and accuracy benchmark.
+ *
+ * 		Pushes a scene through the headless pipeline and reports the frame rate, the time
+ * 		spent per stage, the peak memory use and (when the scene has ground truth) the
+ * 		tracking error of both persons. The results are written as JSON, and can be
+ * 		compared against the results of an earlier build to catch accuracy regressions.
+ *
+ * 		Usage:
+ * 			benchmark --scene=data/synthetic/scene.yml --output=result.json
+ * 			benchmark --scene=data/synthetic/scene.yml --baseline=result.json --tolerance=0.05
+ *
+ * 		To iterate on the tracker, record the tracker inputs once and replay them afterwards:
+ * 			benchmark --scene=data/synthetic/scene.yml --record=synthetic.rec
+ * 			benchmark --scene=data/synthetic/scene.yml --replay=synthetic.rec --baseline=result.json
+ */
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+
+#include <opencv2/opencv.hpp>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "Scene.hpp"
+#include "Tracker.hpp"
+#include "Pipeline.hpp"
+#include "VoxelGrid.hpp"
+#include "GroundPlane.hpp"
+#include "VoxelClusters.hpp"
+
+static const char* Keys =
+	"{help h     |     | print this message }"
+	"{scene      |     | scene description (default: the recorded data set in data/) }"
+	"{frames     | 0   | maximum number of frames to process (0 for all) }"
+	"{warmup     | 5   | number of frames excluded from the timings }"
+	"{output     |     | write the results to this JSON file }"
+	"{baseline   |     | JSON results of an earlier run to compare the tracking error with }"
+	"{tolerance  | 0.05| allowed relative increase of the mean tracking error over the baseline }"
+	"{max_error  | 0   | maximum allowed mean tracking error in millimeters (0 to disable) }"
+	"{undistort  |     | carve with undistorted foreground masks }"
+	"{cache_undistortion | | store the undistortion tables next to the calibration files and reuse them }"
+	"{full_frame |     | process the whole views instead of the projection of the acquisition volume }"
+	"{adapt      | 8   | backgrounds adapt 1 / 2^adapt towards each frame (0 for fixed backgrounds) }"
+	"{occlusion  |     | sample the voxel colors from views in which the voxels are not occluded }"
+	"{full_search|     | search the whole views for the persons instead of the predicted regions }"
+	"{box_labels |     | label the voxels with boxes around the persons instead of clustering }"
+	"{record     |     | record the foreground masks and carved voxels to this file }"
+	"{replay     |     | replay a recording instead of processing the videos }"
+	"{raw_frames |     | read the frames from a raw frame file (see transcode) instead of decoding the videos }"
+	"{sync_tolerance | 0.5 | frames within this many frame periods of each other form a frame set }"
+	"{hold       | 5   | frame periods a view without new frames keeps its last frame }";
+
+// Accumulated statistics of a single value.
+struct Statistic {
+	int Count = 0;
+	double Sum = 0.0;
+	double SumSq = 0.0;
+	double Max = 0.0;
+
+	void Add(double value) {
+		Count++;
+		Sum += value;
+		SumSq += value * value;
+		Max = std::max(Max, value);
+	}
+
+	double Mean() const { return (Count > 0) ? Sum / Count : 0.0; }
+	double Rms() const { return (Count > 0) ? std::sqrt(SumSq / Count) : 0.0; }
+};
+
+// Peak resident set size of this process in megabytes.
+static double peakResidentMB() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+		return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+	}
+	return 0.0;
+#else
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+	return usage.ru_maxrss / (1024.0 * 1024.0);
+#else
+	return usage.ru_maxrss / 1024.0;
+#endif
+#endif
+}
+
+// Reads the ground truth positions (frame,person,x,y), indexed by frame and then by person.
+static std::vector<std::vector<cv::Point2f>> loadGroundTruth(std::string const& path) {
+	std::vector<std::vector<cv::Point2f>> positions;
+
+	std::ifstream file(path);
+	std::string line;
+	std::getline(file, line); // header
+
+	while (std::getline(file, line)) {
+		std::istringstream row(line);
+		int frame;
+		int person;
+		float x;
+		float y;
+		char comma;
+		if (!(row >> frame >> comma >> person >> comma >> x >> comma >> y) || frame < 0 || person < 0) {
+			continue;
+		}
+
+		if (frame >= static_cast<int>(positions.size())) {
+			positions.resize(frame + 1);
+		}
+		if (person >= static_cast<int>(positions[frame].size())) {
+			positions[frame].resize(person + 1, cv::Point2f(NAN, NAN));
+		}
+		positions[frame][person] = cv::Point2f(x, y);
+	}
+
+	return positions;
+}
+
+static void writeStatistic(cv::FileStorage& out, std::string const& name, Statistic const& stat) {
+	out << name << "{";
+	out << "mean" << stat.Mean();
+	out << "rms" << stat.Rms();
+	out << "max" << stat.Max;
+	out << "}";
+}
+
+int main(int argc, char** argv) {
+	cv::CommandLineParser parser(argc, argv, Keys);
+	parser.about("End-to-end throughput and accuracy benchmark");
+	if (parser.has("help")) {
+		parser.printMessage();
+		return 0;
+	}
+
+	std::string scenePath = parser.get<std::string>("scene");
+	int maxFrames = parser.get<int>("frames");
+	int warmup = parser.get<int>("warmup");
+	std::string output = parser.get<std::string>("output");
+	std::string baseline = parser.get<std::string>("baseline");
+	double tolerance = parser.get<double>("tolerance");
+	double maxError = parser.get<double>("max_error");
+
+	PipelineOptions options;
+	options.UndistortMasks = parser.has("undistort");
+	options.CacheUndistortion = parser.has("cache_undistortion");
+	options.VolumeRegion = !parser.has("full_frame");
+	options.BackgroundLearningShift = parser.get<int>("adapt");
+	options.Occlusion = parser.has("occlusion");
+	options.SearchRegions = !parser.has("full_search");
+	options.ClusterLabels = !parser.has("box_labels");
+	options.RecordFile = parser.get<std::string>("record");
+	options.ReplayFile = parser.get<std::string>("replay");
+	options.RawFramesFile = parser.get<std::string>("raw_frames");
+	options.SyncTolerance = parser.get<double>("sync_tolerance");
+	options.HoldFrames = parser.get<int>("hold");
+
+	if (!parser.check()) {
+		parser.printErrors();
+		return 1;
+	}
+
+	Scene scene;
+	if (!scenePath.empty() && !scene.Load(scenePath)) {
+		return 1;
+	}
+
+	std::vector<std::vector<cv::Point2f>> groundTruth;
+	if (!scene.GroundTruth.empty()) {
+		groundTruth = loadGroundTruth(scene.GroundTruth);
+	}
+
+	Pipeline pipeline(scene, options);
+	if (!pipeline.IsReady()) {
+		return 1;
+	}
+
+	// per-stage timings
+	Statistic capture;
+	Statistic foreground;
+	Statistic histograms;
+	Statistic voxels;
+	Statistic coloring;
+	Statistic clustering;
+	Statistic tracking;
+	Statistic labeling;
+	Statistic total;
+	Statistic visible;
+	Statistic clusters;
+
+	// tracking errors of person A and B
+	Statistic errorA;
+	Statistic errorB;
+	Statistic error;
+
+	// distance of each person to the nearest voxel cluster, the independent position estimate
+	Statistic clusterError;
+
+	// distance of each person to the ground plane blob associated with it
+	Statistic groundError;
+
+	int numFrames = 0;
+	while ((maxFrames <= 0 || numFrames < maxFrames) && pipeline.Update()) {
+		int frame = pipeline.FrameIndex;
+		numFrames++;
+
+		// frame sets are not frames of the videos (views may start apart, or all drop a frame), the
+		// ground truth frame follows from the capture time
+		int truthFrame = (scene.Fps > 0.0) ? static_cast<int>(std::lround(pipeline.Timestamp * scene.Fps / 1000.0)) : frame;
+
+		if (frame >= warmup) {
+			StageTimes const& t = pipeline.Times;
+			capture.Add(t.Capture);
+			foreground.Add(t.Foreground);
+			histograms.Add(t.Histograms);
+			voxels.Add(t.Voxels);
+			coloring.Add(t.Coloring);
+			clustering.Add(t.Clustering);
+			tracking.Add(t.Tracking);
+			labeling.Add(t.Labeling);
+			total.Add(t.Total());
+			visible.Add(static_cast<double>(pipeline.Grid->visibleVoxels.size()));
+			clusters.Add(static_cast<double>(pipeline.Clustering->Clusters.size()));
+		}
+
+		// the tracker's person A and B are the first two persons of the ground truth
+		if (truthFrame >= 0 && truthFrame < static_cast<int>(groundTruth.size()) && groundTruth[truthFrame].size() >= 2) {
+			cv::Point3f posA = pipeline.PersonTracker->PersonPosA;
+			cv::Point3f posB = pipeline.PersonTracker->PersonPosB;
+			double eA = cv::norm(cv::Point2f(posA.x, posA.y) - groundTruth[truthFrame][0]);
+			double eB = cv::norm(cv::Point2f(posB.x, posB.y) - groundTruth[truthFrame][1]);
+			if (std::isfinite(eA) && std::isfinite(eB)) {
+				errorA.Add(eA);
+				errorB.Add(eB);
+				error.Add(eA);
+				error.Add(eB);
+			}
+
+			std::vector<VoxelCluster> const& found = pipeline.Clustering->Clusters;
+			if (!found.empty()) {
+				for (int p = 0; p < 2; ++p) {
+					double nearest = INFINITY;
+					for (VoxelCluster const& cluster : found) {
+						nearest = std::min(nearest, cv::norm(cv::Point2f(cluster.Centroid.x, cluster.Centroid.y) - groundTruth[truthFrame][p]));
+					}
+					if (std::isfinite(nearest)) {
+						clusterError.Add(nearest);
+					}
+				}
+			}
+
+			std::vector<GroundBlob> const& blobs = pipeline.Ground->Blobs;
+			std::vector<int> const& assigned = pipeline.Ground->Assigned;
+			for (int p = 0; p < 2 && p < static_cast<int>(assigned.size()); ++p) {
+				if (assigned[p] >= 0) {
+					double e = cv::norm(blobs[assigned[p]].Position - groundTruth[truthFrame][p]);
+					if (std::isfinite(e)) {
+						groundError.Add(e);
+					}
+				}
+			}
+		}
+	}
+
+	double fps = (total.Sum > 0.0) ? (1000.0 * total.Count) / total.Sum : 0.0;
+
+	std::cout << "Frames:          " << numFrames << " (" << total.Count << " timed)" << std::endl;
+	std::cout << "Throughput:      " << fps << " frames/s" << std::endl;
+	std::cout << "Frame time:      " << total.Mean() << " ms" << std::endl;
+	std::cout << "  capture        " << capture.Mean() << " ms" << std::endl;
+	std::cout << "  foreground     " << foreground.Mean() << " ms" << std::endl;
+	std::cout << "  histograms     " << histograms.Mean() << " ms" << std::endl;
+	std::cout << "  voxels         " << voxels.Mean() << " ms" << std::endl;
+	std::cout << "  coloring       " << coloring.Mean() << " ms" << std::endl;
+	std::cout << "  clustering     " << clustering.Mean() << " ms (" << clusters.Mean() << " clusters)" << std::endl;
+	std::cout << "  tracking       " << tracking.Mean() << " ms" << std::endl;
+	std::cout << "  labeling       " << labeling.Mean() << " ms" << std::endl;
+	std::cout << "Peak RSS:        " << peakResidentMB() << " MB" << std::endl;
+	if (error.Count > 0) {
+		std::cout << "Tracking error:  " << error.Mean() << " mm (A " << errorA.Mean() << ", B " << errorB.Mean() << ")" << std::endl;
+	}
+	if (clusterError.Count > 0) {
+		std::cout << "Cluster error:   " << clusterError.Mean() << " mm" << std::endl;
+	}
+	if (groundError.Count > 0) {
+		std::cout << "Ground error:    " << groundError.Mean() << " mm (" << groundError.Count << " associations)" << std::endl;
+	}
+
+	// frames lost or reused per view, to align the frame sets
+	std::vector<StreamStats> syncStats = pipeline.Sync ? pipeline.Sync->Stats : std::vector<StreamStats>();
+	for (size_t i = 0; i < syncStats.size(); ++i) {
+		StreamStats const& s = syncStats[i];
+		if (s.Dropped + s.Skipped + s.Held + s.Missing > 0) {
+			std::cout << "Sync view " << i << ":     " << s.Dropped << " dropped, " << s.Skipped << " skipped, "
+				<< s.Held << " held, " << s.Missing << " missing" << std::endl;
+		}
+	}
+
+	// accuracy regression gate
+	bool passed = true;
+	double baselineError = -1.0;
+	if (!baseline.empty()) {
+		cv::FileStorage previous(baseline, cv::FileStorage::READ | cv::FileStorage::FORMAT_JSON);
+		if (!previous.isOpened() || previous["tracking"].empty()) {
+			std::cerr << "Unable to read the tracking error from " << baseline << std::endl;
+			return 1;
+		}
+		if (error.Count == 0) {
+			std::cerr << "The scene has no ground truth to compare with the baseline" << std::endl;
+			return 1;
+		}
+		baselineError = static_cast<double>(previous["tracking"]["error"]["mean"]);
+		if (error.Mean() > baselineError * (1.0 + tolerance) + 1e-3) {
+			passed = false;
+		}
+	}
+	if (maxError > 0.0) {
+		if (error.Count == 0) {
+			std::cerr << "The scene has no ground truth to compare with the maximum error" << std::endl;
+			return 1;
+		}
+		if (error.Mean() > maxError) {
+			passed = false;
+		}
+	}
+	if (!baseline.empty() || maxError > 0.0) {
+		std::cout << "Accuracy gate:   " << (passed ? "passed" : "FAILED") << std::endl;
+	}
+
+	if (!output.empty()) {
+		cv::FileStorage out(output, cv::FileStorage::WRITE | cv::FileStorage::FORMAT_JSON);
+		out << "scene" << (scenePath.empty() ? std::string("data") : scenePath);
+		out << "views" << pipeline.NumViews;
+		out << "width" << pipeline.ViewWidth;
+		out << "height" << pipeline.ViewHeight;
+		out << "voxels" << pipeline.Grid->numVoxels;
+		out << "frames" << numFrames;
+		out << "timed_frames" << total.Count;
+		out << "fps" << fps;
+		out << "peak_rss_mb" << peakResidentMB();
+		out << "visible_voxels" << visible.Mean();
+		out << "clusters" << clusters.Mean();
+
+		out << "stages_ms" << "{";
+		out << "capture" << capture.Mean();
+		out << "foreground" << foreground.Mean();
+		out << "histograms" << histograms.Mean();
+		out << "voxels" << voxels.Mean();
+		out << "coloring" << coloring.Mean();
+		out << "clustering" << clustering.Mean();
+		out << "tracking" << tracking.Mean();
+		out << "labeling" << labeling.Mean();
+		out << "total" << total.Mean();
+		out << "}";
+
+		if (error.Count > 0) {
+			out << "tracking" << "{";
+			out << "frames" << errorA.Count;
+			writeStatistic(out, "error", error);
+			writeStatistic(out, "error_a", errorA);
+			writeStatistic(out, "error_b", errorB);
+			if (clusterError.Count > 0) {
+				writeStatistic(out, "cluster_error", clusterError);
+			}
+			if (groundError.Count > 0) {
+				writeStatistic(out, "ground_error", groundError);
+			}
+			out << "}";
+		}
+
+		if (!syncStats.empty()) {
+			out << "sync" << "[";
+			for (StreamStats const& s : syncStats) {
+				out << "{";
+				out << "frames" << s.Frames;
+				out << "dropped" << s.Dropped;
+				out << "skipped" << s.Skipped;
+				out << "held" << s.Held;
+				out << "missing" << s.Missing;
+				out << "}";
+			}
+			out << "]";
+		}
+
+		if (!baseline.empty() || maxError > 0.0) {
+			out << "gate" << "{";
+			out << "passed" << static_cast<int>(passed);
+			out << "baseline_error" << baselineError;
+			out << "tolerance" << tolerance;
+			out << "max_error" << maxError;
+			out << "}";
+		}
+	}
+
+	return passed ? 0 : 2;
+}
@@ -0,0 +1,162 @@
+/**
+ * 		Export of the per-frame occupancy and tracks.
+ *
+ * 		Pushes a scene through the headless pipeline and appends the occupied voxels and the
+ * 		positions of both persons of every frame to a binary occupancy stream (see
+ * 		OccupancyStream.hpp for the format). With --input an existing stream is read back
+ * 		and summarized per frame instead, optionally starting at a given frame.
+ *
+ * 		Usage:
+ * 			occupancy --scene=data/synthetic/scene.yml --output=synthetic.occ --keyframes=100
+ * 			occupancy --input=synthetic.occ --from=120
+ */
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <filesystem>
+
+#include <opencv2/opencv.hpp>
+
+#include "Scene.hpp"
+#include "Tracker.hpp"
+#include "Pipeline.hpp"
+#include "VoxelGrid.hpp"
+#include "OccupancyStream.hpp"
+
+static const char* Keys =
+	"{help h     |     | print this message }"
+	"{scene      |     | scene description (default: the recorded data set in data/) }"
+	"{frames     | 0   | maximum number of frames to export (0 for all) }"
+	"{output     |     | occupancy stream to write }"
+	"{keyframes  | 100 | maximum number of frames between keyframes }"
+	"{input      |     | occupancy stream to read back and summarize }"
+	"{from       | 0   | first frame to summarize }"
+	"{undistort  |     | carve with undistorted foreground masks }";
+
+static int summarize(std::string const& path, int from) {
+	OccupancyReader reader;
+	if (!reader.Open(path)) {
+		return 1;
+	}
+
+	OccupancyHeader const& h = reader.Header;
+	std::cout << "Grid " << h.NumX << "x" << h.NumY << "x" << h.NumZ << " voxels of " << h.VoxelSize
+		<< " mm at " << h.Origin << ", " << reader.Keyframes.size() << " keyframes" << std::endl;
+
+	if (from > 0 && !reader.Seek(from)) {
+		std::cerr << "Unable to seek to frame " << from << std::endl;
+		return 1;
+	}
+
+	OccupancyFrame frame;
+	int numFrames = 0;
+	while (reader.Read(frame)) {
+		std::cout << frame.FrameIndex << "\t" << frame.Timestamp << " ms\t" << frame.Voxels.size() << " voxels";
+		for (cv::Point3f const& target : frame.Targets) {
+			std::cout << "\t" << target;
+		}
+		std::cout << std::endl;
+		numFrames++;
+	}
+
+	std::cout << numFrames << " frames" << std::endl;
+	return 0;
+}
+
+int main(int argc, char** argv) {
+	cv::CommandLineParser parser(argc, argv, Keys);
+	parser.about("Export of the per-frame occupancy and tracks");
+	if (parser.has("help")) {
+		parser.printMessage();
+		return 0;
+	}
+
+	std::string scenePath = parser.get<std::string>("scene");
+	int maxFrames = parser.get<int>("frames");
+	std::string output = parser.get<std::string>("output");
+	int keyframes = parser.get<int>("keyframes");
+	std::string input = parser.get<std::string>("input");
+	int from = parser.get<int>("from");
+
+	PipelineOptions options;
+	options.UndistortMasks = parser.has("undistort");
+
+	if (!parser.check()) {
+		parser.printErrors();
+		return 1;
+	}
+	if (!input.empty()) {
+		return summarize(input, from);
+	}
+	if (output.empty()) {
+		std::cerr << "Give an output or an input stream" << std::endl;
+		return 1;
+	}
+
+	Scene scene;
+	if (!scenePath.empty() && !scene.Load(scenePath)) {
+		return 1;
+	}
+
+	Pipeline pipeline(scene, options);
+	if (!pipeline.IsReady()) {
+		return 1;
+	}
+
+	std::shared_ptr<VoxelGrid> grid = pipeline.Grid;
+	OccupancyHeader header;
+	header.NumX = grid->numX;
+	header.NumY = grid->numY;
+	header.NumZ = grid->numZ;
+	header.Origin = cv::Point3i(grid->volumeCorners[0]);
+	header.VoxelSize = grid->voxelSize;
+
+	OccupancyWriter writer;
+	writer.KeyframeInterval = keyframes;
+	if (!writer.Open(output, header)) {
+		return 1;
+	}
+
+	OccupancyFrame frame;
+	frame.Targets.resize(2);
+
+	int numFrames = 0;
+	double pipelineTime = 0.0;
+	double exportTime = 0.0;
+	while ((maxFrames <= 0 || numFrames < maxFrames) && pipeline.Update()) {
+		auto start = std::chrono::steady_clock::now();
+
+		frame.FrameIndex = pipeline.FrameIndex;
+		frame.Timestamp = pipeline.Timestamp;
+		frame.Targets[0] = pipeline.PersonTracker->PersonPosA;
+		frame.Targets[1] = pipeline.PersonTracker->PersonPosB;
+		frame.Voxels = grid->visibleIndices;
+		if (!writer.Write(frame)) {
+			std::cerr << "Unable to write " << output << std::endl;
+			return 1;
+		}
+
+		exportTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		pipelineTime += pipeline.Times.Total();
+		numFrames++;
+	}
+
+	if (!writer.Close()) {
+		std::cerr << "Unable to write " << output << std::endl;
+		return 1;
+	}
+
+	if (numFrames > 0) {
+		std::cout << "Frames:          " << numFrames << std::endl;
+		std::cout << "Frame time:      " << pipelineTime / numFrames << " ms" << std::endl;
+		std::cout << "Export time:     " << exportTime / numFrames << " ms" << std::endl;
+
+		// compared to a bitset over all voxels per frame
+		double rawSize = (header.NumVoxels() / 8.0) * numFrames;
+		double size = static_cast<double>(std::filesystem::file_size(output));
+		std::cout << "Stream size:     " << size / 1024.0 << " kB (" << 100.0 * size / rawSize << "% of raw)" << std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,229 @@
+/**
+ * 		Offscreen rendering of the voxel scene.
+ *
+ * 		Pushes a scene through the headless pipeline and draws the 3D view of every frame
+ * 		with the software rasterizer, so results can be reviewed on machines without a
+ * 		display or OpenGL. Frames are written as an image sequence, as a video, or as raw
+ * 		BGR frames on the standard output to pipe into an encoder.
+ *
+ * 		Usage:
+ * 			render --scene=data/synthetic/scene.yml --output=frames/%05d.png
+ * 			render --scene=data/synthetic/scene.yml --view=0 --output=view0.avi
+ * 			render --raw --width=800 --height=600 | ffmpeg -f rawvideo -pix_fmt bgr24 -s 800x600 -r 25 -i - out.mp4
+ */
+
+#include <cctype>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <iomanip>
+#include <sstream>
+#include <iostream>
+
+#include <opencv2/opencv.hpp>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+#include "Scene.hpp"
+#include "Camera.hpp"
+#include "Pipeline.hpp"
+#include "VoxelGrid.hpp"
+#include "Rasterizer.hpp"
+#include "FrameSnapshot.hpp"
+
+static const char* Keys =
+	"{help h     |     | print this message }"
+	"{scene      |     | scene description (default: the recorded data set in data/) }"
+	"{frames     | 0   | maximum number of frames to render (0 for all) }"
+	"{output     |     | image sequence pattern (e.g. frames/%05d.png) or video file }"
+	"{raw        |     | write raw BGR frames to the standard output }"
+	"{width      | 800 | image width in pixels }"
+	"{height     | 600 | image height in pixels }"
+	"{view       | -1  | render from this camera (-1 for the top view) }"
+	"{eye        |     | render from this position (x,y,z in millimeters), looking at the origin }"
+	"{angle      | 0   | rotation of the scene around the z-axis in degrees }"
+	"{no_labels  |     | hide the tracking lines and boxes }"
+	"{colors     |     | color the voxels as seen by the cameras instead of by person }"
+	"{undistort  |     | carve with undistorted foreground masks }"
+	"{occlusion  |     | sample the voxel colors from views in which the voxels are not occluded }";
+
+// Parses "x,y,z" into a point.
+static bool parsePoint(std::string const& text, cv::Point3f& point) {
+	std::istringstream stream(text);
+	char comma;
+	return static_cast<bool>(stream >> point.x >> comma >> point.y >> comma >> point.z);
+}
+
+// Frame number pattern of an image sequence: the text around a single %d, %Nd or %0Nd.
+struct FramePattern {
+	std::string Prefix;
+	std::string Suffix;
+	int Width = 0;
+	char Fill = ' ';
+
+	std::string Path(int frame) const {
+		std::ostringstream path;
+		path << Prefix << std::setw(Width) << std::setfill(Fill) << frame << Suffix;
+		return path.str();
+	}
+};
+
+// Splits an output path around its frame number conversion; false for any other use of '%'.
+static bool parsePattern(std::string const& text, FramePattern& pattern) {
+	size_t start = text.find('%');
+	if (start == std::string::npos) {
+		return false;
+	}
+
+	size_t end = start + 1;
+	pattern.Fill = ' ';
+	if (end < text.size() && text[end] == '0') {
+		pattern.Fill = '0';
+		end++;
+	}
+
+	size_t digits = end;
+	while (end < text.size() && std::isdigit(static_cast<unsigned char>(text[end])) && end - digits < 3) {
+		end++;
+	}
+	if (end >= text.size() || text[end] != 'd' || text.find('%', end) != std::string::npos) {
+		return false;
+	}
+
+	pattern.Width = (end > digits) ? std::stoi(text.substr(digits, end - digits)) : 0;
+	pattern.Prefix = text.substr(0, start);
+	pattern.Suffix = text.substr(end + 1);
+	return true;
+}
+
+int main(int argc, char** argv) {
+	cv::CommandLineParser parser(argc, argv, Keys);
+	parser.about("Offscreen rendering of the voxel scene");
+	if (parser.has("help")) {
+		parser.printMessage();
+		return 0;
+	}
+
+	std::string scenePath = parser.get<std::string>("scene");
+	int maxFrames = parser.get<int>("frames");
+	std::string output = parser.get<std::string>("output");
+	bool raw = parser.has("raw");
+	int width = parser.get<int>("width");
+	int height = parser.get<int>("height");
+	int view = parser.get<int>("view");
+	std::string eye = parser.get<std::string>("eye");
+	float angle = parser.get<float>("angle");
+
+	PipelineOptions options;
+	options.UndistortMasks = parser.has("undistort");
+	options.Occlusion = parser.has("occlusion");
+	options.VoxelColors = parser.has("colors");
+
+	if (!parser.check()) {
+		parser.printErrors();
+		return 1;
+	}
+	if (output.empty() == !raw) {
+		std::cerr << "Give either an output or --raw" << std::endl;
+		return 1;
+	}
+	if (width <= 0 || height <= 0) {
+		std::cerr << "Invalid image size " << width << "x" << height << std::endl;
+		return 1;
+	}
+
+	// an output with a frame number pattern is written image by image, anything else as a video
+	FramePattern pattern;
+	bool sequence = output.find('%') != std::string::npos;
+	if (sequence && !parsePattern(output, pattern)) {
+		std::cerr << "The output " << output << " needs exactly one frame number (%d, or padded like %05d)" << std::endl;
+		return 1;
+	}
+
+	Scene scene;
+	if (!scenePath.empty() && !scene.Load(scenePath)) {
+		return 1;
+	}
+
+	Pipeline pipeline(scene, options);
+	if (!pipeline.IsReady()) {
+		return 1;
+	}
+
+	Rasterizer rasterizer(width, height);
+	for (int i = 0; i < pipeline.NumViews; i++) {
+		rasterizer.CamCoord(pipeline.Cameras[i]->Corners);
+	}
+	rasterizer.Volume(pipeline.Grid->volumeCorners);
+	rasterizer.ViewAngle = angle;
+	rasterizer.ShowLines = !parser.has("no_labels");
+	rasterizer.ShowBoxes = !parser.has("no_labels");
+
+	if (!eye.empty()) {
+		cv::Point3f position;
+		if (!parsePoint(eye, position)) {
+			std::cerr << "Invalid eye position " << eye << std::endl;
+			return 1;
+		}
+		rasterizer.LookAt(position, cv::Point3f(0, 0, 1));
+	}
+	else if (view >= 0) {
+		if (view >= pipeline.NumViews) {
+			std::cerr << "The scene has no view " << view << std::endl;
+			return 1;
+		}
+		rasterizer.ViewIndex(view);
+	}
+
+	cv::VideoWriter video;
+	if (!output.empty() && !sequence) {
+		video.open(output, cv::VideoWriter::fourcc('M', 'J', 'P', 'G'), scene.Fps, cv::Size(width, height));
+		if (!video.isOpened()) {
+			std::cerr << "Unable to open video " << output << std::endl;
+			return 1;
+		}
+	}
+
+#ifdef _WIN32
+	if (raw) {
+		_setmode(_fileno(stdout), _O_BINARY);
+	}
+#endif
+
+	// fast PNG compression, encoding dominates the time per frame otherwise
+	std::vector<int> pngParams = { cv::IMWRITE_PNG_COMPRESSION, 1 };
+
+	FrameSnapshot snapshot;
+	cv::Mat image;
+
+	int numFrames = 0;
+	while ((maxFrames <= 0 || numFrames < maxFrames) && pipeline.Update()) {
+		pipeline.Snapshot(snapshot, -1);
+		rasterizer.Render(snapshot, image);
+
+		if (raw) {
+			if (std::fwrite(image.data, image.elemSize(), image.total(), stdout) != image.total()) {
+				std::cerr << "Unable to write frame " << pipeline.FrameIndex << std::endl;
+				return 1;
+			}
+		}
+		else if (sequence) {
+			std::string path = pattern.Path(pipeline.FrameIndex);
+			if (!cv::imwrite(path, image, pngParams)) {
+				std::cerr << "Unable to write " << path << std::endl;
+				return 1;
+			}
+		}
+		else {
+			video.write(image);
+		}
+
+		numFrames++;
+	}
+
+	std::cerr << "Rendered " << numFrames << " frames" << std::endl;
+	return 0;
+}
@@ -0,0 +1,474 @@
+/**
+ * 		Synthetic multi-view scene generator.
+ *
+ * 		Places N calibrated cameras on a circle around the acquisition volume and renders
+ * 		a number of moving box and cylinder "persons" with distinct colors. For every
+ * 		camera a calibration file, a background image and a video (or a PNG frame dump)
+ * 		are written, together with the initial person images used by the tracker,
+ * 		the ground truth positions and a scene description that ties it all together.
+ *
+ * 		Usage:
+ * 			scenegen --out=data/synthetic --cameras=4 --persons=2 --frames=300
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <algorithm>
+#include <filesystem>
+
+#include <opencv2/opencv.hpp>
+
+namespace fs = std::filesystem;
+
+// acquisition volume (matches the voxel grid)
+static const float VolumeHalfEdge = 1600.f;
+static const float VolumeHeight = 2400.f;
+
+// floor that is drawn in the backgrounds
+static const float FloorHalfEdge = 4800.f;
+static const float FloorTile = 400.f;
+
+// person dimensions
+static const float PersonRadius = 250.f;
+static const float PersonSpeed = 45.f; // maximum speed in millimeters per frame
+
+// everything closer to the camera than this is not drawn
+static const float NearPlane = 100.f;
+
+static const char* Keys =
+	"{help h     |               | print this message }"
+	"{out        | data/synthetic| output directory }"
+	"{cameras    | 4             | number of cameras }"
+	"{persons    | 2             | number of persons (at least 2, as scenes require) }"
+	"{frames     | 300           | number of frames }"
+	"{width      | 644           | view width in pixels }"
+	"{height     | 484           | view height in pixels }"
+	"{fps        | 25            | frame rate of the videos }"
+	"{fov        | 60            | horizontal field of view in degrees }"
+	"{distance   | 6000          | distance of the cameras to the center of the volume }"
+	"{elevation  | 3000          | height of the cameras above the floor }"
+	"{k1         | 0             | radial distortion coefficient k1 }"
+	"{k2         | 0             | radial distortion coefficient k2 }"
+	"{noise      | 2             | standard deviation of the sensor noise }"
+	"{seed       | 1             | random seed }"
+	"{raw        |               | write PNG frame dumps instead of videos }";
+
+// Calibration of a single synthetic camera.
+struct SynthCamera {
+	std::string name;
+	cv::Matx33d K;
+	cv::Matx33d R;
+	cv::Vec3d t;
+	cv::Vec3d rvec;
+	cv::Vec3d center;
+	cv::Mat distortion;
+};
+
+// Planar convex polygon in world coordinates.
+struct Face {
+	std::vector<cv::Point3d> points;
+	cv::Vec3d normal;
+	cv::Scalar color;
+};
+
+// Moving person, either a box or a cylinder.
+struct Person {
+	bool cylinder;
+	float height;
+	cv::Scalar color;
+	cv::Point2f position;
+	cv::Point2f velocity;
+};
+
+static std::string viewName(int index, int numViews) {
+	static const char* names[] = { "f", "l", "r", "s" };
+	return (numViews <= 4) ? names[index] : std::to_string(index);
+}
+
+// Places a camera at the given center, looking at the given target with the world z-axis up.
+static SynthCamera lookAt(std::string name, cv::Vec3d center, cv::Vec3d target, double fx, int w, int h, double k1, double k2) {
+	SynthCamera cam;
+	cam.name = name;
+	cam.center = center;
+
+	// camera axes in world coordinates (x right, y down, z forward)
+	cv::Vec3d forward = cv::normalize(target - center);
+	cv::Vec3d right = cv::normalize(forward.cross(cv::Vec3d(0, 0, 1)));
+	cv::Vec3d down = forward.cross(right);
+
+	cam.R = cv::Matx33d(
+		right[0], right[1], right[2],
+		down[0], down[1], down[2],
+		forward[0], forward[1], forward[2]);
+	cam.t = -(cam.R * center);
+	cv::Rodrigues(cam.R, cam.rvec);
+
+	cam.K = cv::Matx33d(
+		fx, 0, w / 2.0,
+		0, fx, h / 2.0,
+		0, 0, 1);
+
+	cam.distortion = (cv::Mat_<double>(4, 1) << k1, k2, 0, 0);
+	return cam;
+}
+
+// Writes a calibration file in the layout read by Camera::LoadParams.
+static bool writeCalibration(SynthCamera const& cam, fs::path const& path) {
+	std::ofstream file(path);
+	if (!file.is_open()) {
+		return false;
+	}
+
+	file << std::setprecision(9);
+	for (int y = 0; y < 3; y ++) {
+		file << cam.K(y, 0) << " " << cam.K(y, 1) << " " << cam.K(y, 2) << "\n";
+	}
+	for (int x = 0; x < 4; x ++) {
+		file << cam.distortion.at<double>(x) << ((x < 3) ? " " : "\n");
+	}
+	file << cam.rvec[0] << " " << cam.rvec[1] << " " << cam.rvec[2] << "\n";
+	file << cam.t[0] << " " << cam.t[1] << " " << cam.t[2] << "\n";
+	return true;
+}
+
+// Projects a face into the view. Returns false if (part of) the face cannot be drawn.
+static bool projectFace(SynthCamera const& cam, Face const& face, std::vector<cv::Point>& pts) {
+	std::vector<cv::Point3d> objectPoints;
+	for (cv::Point3d const& p : face.points) {
+		cv::Vec3d pc = cam.R * cv::Vec3d(p.x, p.y, p.z) + cam.t;
+
+		// reject faces that reach behind the camera or too far outside the field of view
+		if (pc[2] < NearPlane) {
+			return false;
+		}
+		double nx = pc[0] / pc[2];
+		double ny = pc[1] / pc[2];
+		if ((nx * nx + ny * ny) > 4.0) {
+			return false;
+		}
+		objectPoints.push_back(p);
+	}
+
+	std::vector<cv::Point2d> imagePoints;
+	cv::projectPoints(objectPoints, cam.rvec, cam.t, cam.K, cam.distortion, imagePoints);
+
+	pts.clear();
+	for (cv::Point2d const& p : imagePoints) {
+		pts.push_back(cv::Point(cvRound(p.x), cvRound(p.y)));
+	}
+	return true;
+}
+
+// Draws the faces back to front, skipping faces that point away from the camera.
+static void drawFaces(cv::Mat& image, SynthCamera const& cam, std::vector<Face> const& faces) {
+	std::vector<std::pair<double, int>> order;
+	for (int i = 0; i < static_cast<int>(faces.size()); i ++) {
+		cv::Vec3d centroid(0, 0, 0);
+		for (cv::Point3d const& p : faces[i].points) {
+			centroid += cv::Vec3d(p.x, p.y, p.z);
+		}
+		centroid /= static_cast<double>(faces[i].points.size());
+
+		cv::Vec3d toCamera = cam.center - centroid;
+		if (toCamera.dot(faces[i].normal) <= 0) {
+			continue;
+		}
+		order.push_back(std::make_pair(cv::norm(toCamera), i));
+	}
+	std::sort(order.begin(), order.end(), std::greater<>());
+
+	std::vector<cv::Point> pts;
+	for (auto const& o : order) {
+		if (projectFace(cam, faces[o.second], pts)) {
+			cv::fillConvexPoly(image, pts, faces[o.second].color, cv::LINE_8);
+		}
+	}
+}
+
+// Simple directional shading so that the sides of a person are distinguishable.
+static cv::Scalar shade(cv::Scalar color, cv::Vec3d normal) {
+	static const cv::Vec3d light = cv::normalize(cv::Vec3d(0.4, 0.3, 1.0));
+	double intensity = 0.6 + 0.4 * std::max(0.0, normal.dot(light));
+	return color * intensity;
+}
+
+// Builds the visible faces (sides and top) of a person.
+static void personFaces(Person const& person, std::vector<Face>& faces) {
+	double cx = person.position.x;
+	double cy = person.position.y;
+	double h = person.height;
+
+	// boxes are four-sided prisms, cylinders are approximated by many sides
+	int sides = person.cylinder ? 24 : 4;
+	double offset = person.cylinder ? 0.0 : CV_PI / 4.0;
+	double radius = person.cylinder ? PersonRadius : PersonRadius * std::sqrt(2.0);
+
+	std::vector<cv::Point2d> ring;
+	for (int i = 0; i < sides; i ++) {
+		double a = offset + (2.0 * CV_PI * i) / sides;
+		ring.push_back(cv::Point2d(cx + radius * std::cos(a), cy + radius * std::sin(a)));
+	}
+
+	for (int i = 0; i < sides; i ++) {
+		cv::Point2d p0 = ring[i];
+		cv::Point2d p1 = ring[(i + 1) % sides];
+
+		Face side;
+		side.points = {
+			cv::Point3d(p0.x, p0.y, 0), cv::Point3d(p1.x, p1.y, 0),
+			cv::Point3d(p1.x, p1.y, h), cv::Point3d(p0.x, p0.y, h)
+		};
+		double a = offset + (2.0 * CV_PI * (i + 0.5)) / sides;
+		side.normal = cv::Vec3d(std::cos(a), std::sin(a), 0);
+		side.color = shade(person.color, side.normal);
+		faces.push_back(side);
+	}
+
+	Face top;
+	for (cv::Point2d const& p : ring) {
+		top.points.push_back(cv::Point3d(p.x, p.y, h));
+	}
+	top.normal = cv::Vec3d(0, 0, 1);
+	top.color = shade(person.color, top.normal);
+	faces.push_back(top);
+}
+
+// Renders the static part of the scene: a wall gradient and a tiled floor.
+static cv::Mat renderBackground(SynthCamera const& cam, cv::Size size) {
+	cv::Mat image(size, CV_8UC3);
+	for (int y = 0; y < size.height; y ++) {
+		uint8_t v = cv::saturate_cast<uint8_t>(90 + (60.0 * y) / size.height);
+		image.row(y).setTo(cv::Scalar(v + 6, v + 3, v));
+	}
+
+	std::vector<Face> tiles;
+	int n = static_cast<int>((2 * FloorHalfEdge) / FloorTile);
+	for (int i = 0; i < n; i ++) {
+		for (int j = 0; j < n; j ++) {
+			double x0 = -FloorHalfEdge + i * FloorTile;
+			double y0 = -FloorHalfEdge + j * FloorTile;
+
+			Face tile;
+			tile.points = {
+				cv::Point3d(x0, y0, 0), cv::Point3d(x0 + FloorTile, y0, 0),
+				cv::Point3d(x0 + FloorTile, y0 + FloorTile, 0), cv::Point3d(x0, y0 + FloorTile, 0)
+			};
+			tile.normal = cv::Vec3d(0, 0, 1);
+			tile.color = ((i + j) % 2) ? cv::Scalar(175, 178, 180) : cv::Scalar(140, 142, 145);
+			tiles.push_back(tile);
+		}
+	}
+	drawFaces(image, cam, tiles);
+	return image;
+}
+
+static void addNoise(cv::Mat& image, cv::RNG& rng, double sigma) {
+	if (sigma <= 0) {
+		return;
+	}
+	cv::Mat noise(image.size(), CV_16SC3);
+	rng.fill(noise, cv::RNG::NORMAL, cv::Scalar::all(0), cv::Scalar::all(sigma));
+	cv::Mat noisy;
+	image.convertTo(noisy, CV_16SC3);
+	noisy += noise;
+	noisy.convertTo(image, CV_8UC3);
+}
+
+// Moves the person with a bounded random walk that stays inside the volume.
+static void stepPerson(Person& person, cv::RNG& rng) {
+	person.velocity += cv::Point2f(rng.gaussian(4.0), rng.gaussian(4.0));
+
+	float speed = std::sqrt(person.velocity.dot(person.velocity));
+	if (speed > PersonSpeed) {
+		person.velocity *= PersonSpeed / speed;
+	}
+
+	person.position += person.velocity;
+
+	float limit = VolumeHalfEdge - PersonRadius * 1.5f;
+	if (std::abs(person.position.x) > limit) {
+		person.position.x = std::copysign(limit, person.position.x);
+		person.velocity.x = -person.velocity.x;
+	}
+	if (std::abs(person.position.y) > limit) {
+		person.position.y = std::copysign(limit, person.position.y);
+		person.velocity.y = -person.velocity.y;
+	}
+}
+
+// Renders a single person on black and crops it, to serve as the tracker's initial color model.
+static cv::Mat renderInitImage(std::vector<SynthCamera> const& cameras, Person const& person, cv::Size size) {
+	std::vector<Face> faces;
+	personFaces(person, faces);
+
+	for (SynthCamera const& cam : cameras) {
+		cv::Mat image = cv::Mat::zeros(size, CV_8UC3);
+		drawFaces(image, cam, faces);
+
+		cv::Mat gray;
+		cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
+		cv::Rect box = cv::boundingRect(gray);
+		if (box.area() > 0) {
+			return image(box).clone();
+		}
+	}
+	return cv::Mat();
+}
+
+int main(int argc, char** argv) {
+	cv::CommandLineParser parser(argc, argv, Keys);
+	parser.about("Synthetic multi-view scene generator");
+	if (parser.has("help")) {
+		parser.printMessage();
+		return 0;
+	}
+
+	fs::path out = parser.get<std::string>("out");
+	int numViews = parser.get<int>("cameras");
+	int numPersons = parser.get<int>("persons");
+	int numFrames = parser.get<int>("frames");
+	cv::Size size(parser.get<int>("width"), parser.get<int>("height"));
+	double fps = parser.get<double>("fps");
+	double fov = parser.get<double>("fov");
+	double distance = parser.get<double>("distance");
+	double elevation = parser.get<double>("elevation");
+	double k1 = parser.get<double>("k1");
+	double k2 = parser.get<double>("k2");
+	double noise = parser.get<double>("noise");
+	bool raw = parser.has("raw");
+	cv::RNG rng(parser.get<uint64_t>("seed"));
+
+	if (!parser.check() || numViews < 2 || numPersons < 2 || numFrames < 1 || size.area() <= 0) {
+		parser.printErrors();
+		parser.printMessage();
+		return 1;
+	}
+
+	fs::create_directories(out);
+
+	// cameras on a circle around the volume, looking at its center
+	double fx = (size.width / 2.0) / std::tan((fov * CV_PI / 180.0) / 2.0);
+	std::vector<SynthCamera> cameras;
+	for (int i = 0; i < numViews; i ++) {
+		double a = (2.0 * CV_PI * i) / numViews + (CV_PI / 8.0);
+		cv::Vec3d center(distance * std::cos(a), distance * std::sin(a), elevation);
+		cameras.push_back(lookAt(viewName(i, numViews), center, cv::Vec3d(0, 0, 800), fx, size.width, size.height, k1, k2));
+	}
+
+	// persons with evenly spaced hues, alternating between boxes and cylinders
+	std::vector<Person> persons;
+	for (int p = 0; p < numPersons; p ++) {
+		cv::Mat hsv(1, 1, CV_8UC3, cv::Scalar((180 * p) / numPersons, 220, 210));
+		cv::Mat bgr;
+		cv::cvtColor(hsv, bgr, cv::COLOR_HSV2BGR);
+		cv::Vec3b c = bgr.at<cv::Vec3b>(0, 0);
+
+		Person person;
+		person.cylinder = (p % 2) == 1;
+		person.height = rng.uniform(1650.f, 1900.f);
+		person.color = cv::Scalar(c[0], c[1], c[2]);
+		float limit = VolumeHalfEdge - PersonRadius * 2.f;
+		person.position = cv::Point2f(rng.uniform(-limit, limit), rng.uniform(-limit, limit));
+		person.velocity = cv::Point2f(rng.uniform(-10.f, 10.f), rng.uniform(-10.f, 10.f));
+		persons.push_back(person);
+	}
+
+	cv::FileStorage scene((out / "scene.yml").string(), cv::FileStorage::WRITE);
+	scene << "width" << size.width;
+	scene << "height" << size.height;
+	scene << "fps" << fps;
+	scene << "frames" << numFrames;
+
+	// calibration, background and video per view
+	std::vector<cv::Mat> backgrounds;
+	std::vector<cv::VideoWriter> writers(numViews);
+	scene << "views" << "[";
+	for (int i = 0; i < numViews; i ++) {
+		SynthCamera const& cam = cameras[i];
+
+		std::string calibration = "camparam_" + cam.name + ".ini";
+		std::string background = "background_" + cam.name + ".bmp";
+		std::string video = raw ? ("frames_" + cam.name + "/%05d.png") : ("video_" + cam.name + ".avi");
+
+		if (!writeCalibration(cam, out / calibration)) {
+			std::cerr << "Unable to write " << (out / calibration).string() << std::endl;
+			return 1;
+		}
+
+		cv::Mat bg = renderBackground(cam, size);
+		backgrounds.push_back(bg.clone());
+		addNoise(bg, rng, noise);
+		cv::imwrite((out / background).string(), bg);
+
+		if (raw) {
+			fs::create_directories(out / ("frames_" + cam.name));
+		}
+		else if (!writers[i].open((out / video).string(), cv::VideoWriter::fourcc('M', 'J', 'P', 'G'), fps, size)) {
+			std::cerr << "Unable to open " << (out / video).string() << " for writing" << std::endl;
+			return 1;
+		}
+
+		scene << "{" << "name" << cam.name << "calibration" << calibration << "background" << background << "video" << video << "}";
+	}
+	scene << "]";
+
+	// initial person images for the color models of the tracker
+	scene << "persons" << "[";
+	for (int p = 0; p < numPersons; p ++) {
+		std::string init = "init-person" + std::to_string(p + 1) + ".jpg";
+		cv::Mat image = renderInitImage(cameras, persons[p], size);
+		if (!image.empty()) {
+			cv::imwrite((out / init).string(), image);
+		}
+		scene << init;
+	}
+	scene << "]";
+	scene << "groundtruth" << "groundtruth.csv";
+	scene.release();
+
+	std::ofstream groundTruth(out / "groundtruth.csv");
+	groundTruth << "frame,person,x,y" << std::endl;
+
+	std::cout << "Rendering " << numFrames << " frames of " << numViews << " views ";
+
+	// render the sequence
+	std::vector<Face> faces;
+	for (int f = 0; f < numFrames; f ++) {
+		faces.clear();
+		for (int p = 0; p < numPersons; p ++) {
+			personFaces(persons[p], faces);
+			groundTruth << f << "," << p << "," << persons[p].position.x << "," << persons[p].position.y << "\n";
+		}
+
+		for (int i = 0; i < numViews; i ++) {
+			cv::Mat frame = backgrounds[i].clone();
+			drawFaces(frame, cameras[i], faces);
+			addNoise(frame, rng, noise);
+
+			if (raw) {
+				char name[32];
+				std::snprintf(name, sizeof(name), "%05d.png", f);
+				cv::imwrite((out / ("frames_" + cameras[i].name) / name).string(), frame);
+			}
+			else {
+				writers[i].write(frame);
+			}
+		}
+
+		for (int p = 0; p < numPersons; p ++) {
+			stepPerson(persons[p], rng);
+		}
+
+		if ((f % std::max(1, numFrames / 10)) == 0) {
+			std::cout << ".";
+		}
+	}
+
+	std::cout << " Done." << std::endl;
+	return 0;
+}
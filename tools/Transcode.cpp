@@ -0,0 +1,139 @@
+/**
+ * 		Transcoding of the videos of a scene into a raw frame file.
+ *
+ * 		Decodes the videos of all views once and writes the frames uncompressed, with their capture
+ * 		times, to a single file (see RawFrames.hpp for the format). Runs with --raw_frames then map
+ * 		that file instead of decoding the videos again. With --input an existing file is read back
+ * 		and summarized instead, along with the time needed to touch all of its frames.
+ *
+ * 		Usage:
+ * 			transcode --scene=data/synthetic/scene.yml --output=synthetic.raw
+ * 			transcode --input=synthetic.raw
+ */
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include <opencv2/opencv.hpp>
+
+#include "Scene.hpp"
+#include "RawFrames.hpp"
+
+static const char* Keys =
+	"{help h     |     | print this message }"
+	"{scene      |     | scene description (default: the recorded data set in data/) }"
+	"{frames     | 0   | maximum number of frame sets to transcode (0 for all) }"
+	"{output     |     | raw frame file to write }"
+	"{input      |     | raw frame file to read back and summarize }";
+
+static int summarize(std::string const& path) {
+	RawFrameReader reader;
+	if (!reader.Open(path)) {
+		return 1;
+	}
+
+	std::cout << reader.NumFrames << " frame sets of " << reader.NumViews << " views, " << reader.ViewWidth << "x"
+		<< reader.ViewHeight << " at " << reader.Fps << " fps" << std::endl;
+
+	// sum a byte of every cache line, so all pages are actually read
+	auto start = std::chrono::steady_clock::now();
+	std::vector<cv::Mat> frames;
+	double timestamp = 0.0;
+	uint64_t checksum = 0;
+	int numFrames = 0;
+	while (reader.Read(frames, timestamp)) {
+		for (cv::Mat const& frame : frames) {
+			uint8_t const* data = frame.ptr<uint8_t>();
+			size_t bytes = frame.total() * frame.elemSize();
+			for (size_t i = 0; i < bytes; i += 64) {
+				checksum += data[i];
+			}
+		}
+		numFrames++;
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << numFrames << " frame sets read in " << seconds * 1000.0 << " ms ("
+		<< ((seconds > 0.0) ? numFrames / seconds : 0.0) << " per second, checksum " << checksum << ")" << std::endl;
+	return 0;
+}
+
+int main(int argc, char** argv) {
+	cv::CommandLineParser parser(argc, argv, Keys);
+	parser.about("Transcoding of the videos of a scene into a raw frame file");
+	if (parser.has("help")) {
+		parser.printMessage();
+		return 0;
+	}
+
+	std::string scenePath = parser.get<std::string>("scene");
+	int maxFrames = parser.get<int>("frames");
+	std::string output = parser.get<std::string>("output");
+	std::string input = parser.get<std::string>("input");
+
+	if (!parser.check()) {
+		parser.printErrors();
+		return 1;
+	}
+	if (!input.empty()) {
+		return summarize(input);
+	}
+	if (output.empty()) {
+		std::cerr << "Give an output or an input file" << std::endl;
+		return 1;
+	}
+
+	Scene scene;
+	if (!scenePath.empty() && !scene.Load(scenePath)) {
+		return 1;
+	}
+
+	int numViews = static_cast<int>(scene.Views.size());
+	std::vector<cv::VideoCapture> captures;
+	for (ViewSource const& view : scene.Views) {
+		captures.push_back(cv::VideoCapture(view.video));
+		if (!captures.back().isOpened()) {
+			std::cerr << "Unable to open video " << view.video << std::endl;
+			return 1;
+		}
+	}
+
+	RawFrameWriter writer;
+	if (!writer.Open(output, numViews, scene.Width, scene.Height, scene.Fps)) {
+		return 1;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	std::vector<cv::Mat> frames(numViews);
+	std::vector<double> timestamps(numViews);
+	int numFrames = 0;
+	while (maxFrames <= 0 || numFrames < maxFrames) {
+		// the sequence ends with the shortest video
+		bool complete = true;
+		for (int i = 0; i < numViews && complete; ++i) {
+			complete = captures[i].read(frames[i]) && !frames[i].empty();
+			timestamps[i] = captures[i].get(cv::CAP_PROP_POS_MSEC);
+		}
+		if (!complete) {
+			break;
+		}
+
+		if (!writer.Write(frames, timestamps)) {
+			std::cerr << "Unable to write frames " << output << std::endl;
+			return 1;
+		}
+		numFrames++;
+	}
+
+	if (!writer.Close()) {
+		std::cerr << "Unable to write frames " << output << std::endl;
+		return 1;
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << numFrames << " frame sets of " << numViews << " views transcoded to " << output << " in "
+		<< seconds << " s" << std::endl;
+	return 0;
+}